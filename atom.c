@@ -55,6 +55,7 @@ void Atom_init(Atom *atom)
   atom->d_x = NULL;
   atom->d_v = NULL;
   atom->d_f = NULL;
+  atom->d_xold = NULL;
   atom->comm_size = 3;
   atom->reverse_size = 3;
   atom->border_size = 3;
@@ -72,6 +73,7 @@ void Atom_destroy(Atom *atom)
     acc_free(atom->d_x);
     acc_free(atom->d_v);
     acc_free(atom->d_f);
+    acc_free(atom->d_xold);
   }
 }
 
@@ -107,9 +109,11 @@ void Atom_growarray(Atom *atom)
   acc_free(atom->d_x);
   acc_free(atom->d_v);
   acc_free(atom->d_f);
+  acc_free(atom->d_xold);
   atom->d_x = (MMD_float*) acc_malloc(atom->nmax*PAD*sizeof(MMD_float));
   atom->d_v = (MMD_float*) acc_malloc(atom->nmax*PAD*sizeof(MMD_float));
   atom->d_f = (MMD_float*) acc_malloc(atom->nmax*PAD*sizeof(MMD_float));
+  atom->d_xold = (MMD_float*) acc_malloc(atom->nmax*PAD*sizeof(MMD_float));
   if(atom->x == NULL || atom->v == NULL || atom->f == NULL || atom->xold == NULL) {
     printf("ERROR: No memory for atoms\n");
   }
@@ -194,13 +198,30 @@ void Atom_pack_comm(Atom *atom, int n_, int* list_, MMD_float* buf_, int* pbc_fl
   }
 }
 
-void Atom_unpack_comm(Atom *atom, int n_, int first_, MMD_float* buf_)
+void Atom_unpack_comm(Atom *atom, int n_, int first_, int* list_, MMD_float* buf_)
 {
   const int n = 3*n_;
   const int first = first_*PAD;
   MMD_float* const restrict x_ = atom->d_x;
   const MMD_float* const restrict buf = buf_;
 
+  // sorted ghosts: list holds the slot of every received atom
+
+  if(list_) {
+    const int nlist = n_;
+    const int* const restrict list = list_;
+
+    #pragma acc kernels deviceptr(x_,buf) copyin(list[0:nlist])
+    for(int i = 0; i < nlist; i++) {
+      const int j = list[i];
+      x_[j*PAD+0] = buf[3 * i];
+      x_[j*PAD+1] = buf[3 * i + 1];
+      x_[j*PAD+2] = buf[3 * i + 2];
+    }
+
+    return;
+  }
+
   #pragma acc kernels deviceptr(x_,buf)
   for(int i = 0; i < n; i++) {
     x_[first + i] = buf[i];
@@ -210,9 +231,20 @@ void Atom_unpack_comm(Atom *atom, int n_, int first_, MMD_float* buf_)
   }
 }
 
-void Atom_pack_reverse(Atom *atom, int n, int first, MMD_float* buf)
+void Atom_pack_reverse(Atom *atom, int n, int first, int* list, MMD_float* buf)
 {
-  int i;
+  int i, j;
+
+  if(list) {
+    for(i = 0; i < n; i++) {
+      j = list[i];
+      buf[3 * i] = atom->f[j][0];
+      buf[3 * i + 1] = atom->f[j][1];
+      buf[3 * i + 2] = atom->f[j][2];
+    }
+
+    return;
+  }
 
   for(i = 0; i < n; i++) {
     buf[3 * i] = atom->f[first + i][0];
@@ -360,47 +392,48 @@ void Atom_destroy_2d_MMD_float_array(Atom *atom, MMD_float** array)
   }
 }
 
-void Atom_sort(Atom *atom, Neighbor *neighbor)
+static void Atom_grow_copy(Atom *atom)
 {
+  if(atom->copy_size < atom->nmax) {
+    Atom_destroy_2d_MMD_float_array(atom, atom->x_copy);
+    Atom_destroy_2d_MMD_float_array(atom, atom->v_copy);
+    atom->x_copy = (MMD_float**) Atom_create_2d_MMD_float_array(atom, atom->nmax, PAD);
+    atom->v_copy = (MMD_float**) Atom_create_2d_MMD_float_array(atom, atom->nmax, PAD);
+    atom->copy_size = atom->nmax;
+  }
+}
 
-  Neighbor_binatoms(neighbor, atom, atom->nlocal);
-
-  atom->binpos = neighbor->bincount;
-  atom->bins = neighbor->bins;
+void Atom_sort(Atom *atom, Neighbor *neighbor)
+{
+  // Morton order of the bins of the local atoms is the new order (the
+  // counting sort by bin index if the bin grid does not fit into the keys)
 
-  const int mbins = neighbor->mbins;
-  const int atoms_per_bin = neighbor->atoms_per_bin;
+  const int nlocal = atom->nlocal;
+  const int* bins;
 
-  {
-    for(int i=1; i<mbins; i++)
-	  atom->binpos[i] += atom->binpos[i-1];
-    if(atom->copy_size < atom->nmax) {
-	  Atom_destroy_2d_MMD_float_array(atom, atom->x_copy);
-	  Atom_destroy_2d_MMD_float_array(atom, atom->v_copy);
-      atom->x_copy = (MMD_float**) Atom_create_2d_MMD_float_array(atom, atom->nmax, PAD);
-      atom->v_copy = (MMD_float**) Atom_create_2d_MMD_float_array(atom, atom->nmax, PAD);
-      atom->copy_size = atom->nmax;
-    }
+  if(Neighbor_sort_morton(neighbor, atom, nlocal))
+    bins = neighbor->morton_atoms;
+  else {
+    Neighbor_binatoms(neighbor, atom, nlocal);
+    bins = neighbor->bins;
   }
 
+  Atom_grow_copy(atom);
+
   MMD_float* new_x = &atom->x_copy[0][0];
   MMD_float* new_v = &atom->v_copy[0][0];
   MMD_float* old_x = &atom->x[0][0];
   MMD_float* old_v = &atom->v[0][0];
 
-  for(int mybin = 0; mybin<mbins; mybin++) {
-    const int start = mybin>0 ? atom->binpos[mybin-1]:0;
-    const int count = atom->binpos[mybin] - start;
-    for(int k=0; k<count; k++) {
-	  const int new_i = start+k;
-	  const int old_i = atom->bins[mybin*atoms_per_bin+k];
-	  new_x[new_i*PAD+0] = old_x[old_i*PAD+0];
-	  new_x[new_i*PAD+1] = old_x[old_i*PAD+1];
-	  new_x[new_i*PAD+2] = old_x[old_i*PAD+2];
-	  new_v[new_i*PAD+0] = old_v[old_i*PAD+0];
-	  new_v[new_i*PAD+1] = old_v[old_i*PAD+1];
-	  new_v[new_i*PAD+2] = old_v[old_i*PAD+2];
-    }
+  #pragma omp parallel for
+  for(int new_i = 0; new_i < nlocal; new_i++) {
+    const int old_i = bins[new_i];
+    new_x[new_i*PAD+0] = old_x[old_i*PAD+0];
+    new_x[new_i*PAD+1] = old_x[old_i*PAD+1];
+    new_x[new_i*PAD+2] = old_x[old_i*PAD+2];
+    new_v[new_i*PAD+0] = old_v[old_i*PAD+0];
+    new_v[new_i*PAD+1] = old_v[old_i*PAD+1];
+    new_v[new_i*PAD+2] = old_v[old_i*PAD+2];
   }
 
   {
@@ -413,3 +446,43 @@ void Atom_sort(Atom *atom, Neighbor *neighbor)
     atom->v_copy = v_tmp;
   }
 }
+
+void Atom_sort_ghosts(Atom *atom, Neighbor *neighbor, int* map)
+{
+  // ghosts in the bin order of all atoms, the local atoms stay in place
+  // map[k] = new slot of the ghost that arrived as nlocal + k
+
+  const int nlocal = atom->nlocal;
+  const int nall = nlocal + atom->nghost;
+
+  Neighbor_binatoms(neighbor, atom, nall);
+
+  const int* const bins = neighbor->bins;
+  int next = nlocal;
+
+  for(int m = 0; m < nall; m++) {
+    const int i = bins[m];
+
+    if(i >= nlocal) map[i - nlocal] = next++;
+  }
+
+  Atom_grow_copy(atom);
+
+  MMD_float* new_x = &atom->x_copy[0][0];
+  MMD_float* old_x = &atom->x[0][0];
+
+  #pragma omp parallel for
+  for(int i = nlocal; i < nall; i++) {
+    const int new_i = map[i - nlocal];
+    new_x[new_i*PAD+0] = old_x[i*PAD+0];
+    new_x[new_i*PAD+1] = old_x[i*PAD+1];
+    new_x[new_i*PAD+2] = old_x[i*PAD+2];
+  }
+
+  #pragma omp parallel for
+  for(int i = nlocal; i < nall; i++) {
+    old_x[i*PAD+0] = new_x[i*PAD+0];
+    old_x[i*PAD+1] = new_x[i*PAD+1];
+    old_x[i*PAD+2] = new_x[i*PAD+2];
+  }
+}
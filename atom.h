@@ -103,31 +103,16 @@ struct DualView<Scalar,RandomRead> {
   }
   
 }*/
+// neighbor k of atom i is neighbors[FIRSTNEIGH(firstneigh, i) + k * DS1(nmax, maxneighs)]:
+// packed CSR lists by default, a nmax x maxneighs rectangle with i fastest for USELAYOUTLEFT
 #ifdef USELAYOUTLEFT
-#define DS0(a,b) 1
+#define FIRSTNEIGH(first, i) (i)
 #define DS1(a,b) a
 #else
-#define DS0(a,b) b
+#define FIRSTNEIGH(first, i) ((first)[i])
 #define DS1(a,b) 1
 #endif
 
-/*static inline int DS1(const int &n0, const int &n1) {
-#ifdef USELAYOUTLEFT
-  return n1;
-#else
-  return 1;
-#endif
-}
-
-
-static inline int DS0(const int &n0, const int &n1) {
-#ifdef USELAYOUTLEFT
-  return 1;
-#else
-  return n0;
-#endif 
-}*/
-
 struct Neighbor_s;
 struct Box {
   MMD_float xprd, yprd, zprd;
@@ -147,6 +132,7 @@ typedef struct
     MMD_float** f;
 
     MMD_float* d_x,*d_v,*d_f;
+    MMD_float* d_xold;                // positions at the last neighbor build
     MMD_float** xold;
 
     ThreadData* threads;
@@ -156,8 +142,6 @@ typedef struct
 
     struct Box box;
 
-    int* binpos;
-    int* bins;
     MMD_float** x_copy;
     MMD_float** v_copy;
     int copy_size;
@@ -172,8 +156,8 @@ void Atom_growarray(Atom *);
 void Atom_copy(Atom *, int, int);
 
 void Atom_pack_comm(Atom *, int, int*, MMD_float*, int*);
-void Atom_unpack_comm(Atom *, int, int, MMD_float*);
-void Atom_pack_reverse(Atom *, int, int, MMD_float*);
+void Atom_unpack_comm(Atom *, int, int, int*, MMD_float*);
+void Atom_pack_reverse(Atom *, int, int, int*, MMD_float*);
 void Atom_unpack_reverse(Atom *, int, int*, MMD_float*);
 
 int Atom_pack_border(Atom *, int, MMD_float*, int*);
@@ -187,6 +171,7 @@ MMD_float** Atom_create_2d_MMD_float_array(Atom *, int, int);
 void Atom_destroy_2d_MMD_float_array(Atom *, MMD_float**);
 
 void Atom_sort(Atom *atom, struct Neighbor_s *neighbor);
+void Atom_sort_ghosts(Atom *atom, struct Neighbor_s *neighbor, int* map);
 
 void Atom_sync_device(Atom *, void* d_ptr, void* h_ptr,int bytes);
 void Atom_sync_host(Atom *, void* h_ptr, void* d_ptr,int bytes);
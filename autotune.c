@@ -0,0 +1,231 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mpi.h"
+#include "ljs.h"
+#include "atom.h"
+#include "force.h"
+#include "force_lj.h"
+#include "force_eam.h"
+#include "neighbor.h"
+#include "integrate.h"
+#include "thermo.h"
+#include "comm.h"
+#include "timer.h"
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+/* one trial segment: restart from the saved state with the current neighbor
+   cutoff, bins and interval (same setup as the main run) and return the
+   steps/s of the slowest rank, danger = # of builds after some atom moved
+   more than skin/2 */
+
+static double autotune_trial(Atom *atom, Force *force, Neighbor *neighbor, Comm *comm,
+                             Thermo *thermo, Integrate *integrate, Timer *timer,
+                             const MMD_float* xsave, const MMD_float* vsave, int nsave, MMD_float dtforce, int* danger)
+{
+  double time, maxtime;
+
+  atom->nlocal = nsave;
+  atom->nghost = 0;
+  memcpy(&atom->x[0][0], xsave, nsave * PAD * sizeof(MMD_float));
+  memcpy(&atom->v[0][0], vsave, nsave * PAD * sizeof(MMD_float));
+
+  Comm_setup(comm, neighbor->cutneigh, atom);
+  Neighbor_setup(neighbor, atom);
+  neighbor->skin = neighbor->cutneigh - sqrt(force->cutforcesq);
+
+  Comm_exchange(comm, atom);
+  Comm_borders(comm, atom);
+  if(comm->ghost_sort)
+    Comm_sort_ghosts(comm, atom, neighbor);
+  Neighbor_build(neighbor, atom);
+  Atom_sync_device(atom, atom->d_x, &atom->x[0][0], atom->nmax * PAD * sizeof(MMD_float));
+
+  force->evflag = 0;
+
+  if(force->style == FORCELJ)
+    ForceLJ_compute((ForceLJ *) force, atom, neighbor, comm, comm->me);
+  else
+    ForceEAM_compute((ForceEAM *) force, atom, neighbor, comm, comm->me);
+
+  if(neighbor->halfneigh && neighbor->ghost_newton) {
+    Comm_reverse_communicate(comm, atom);
+    Atom_sync_device(atom, atom->d_f, &atom->f[0][0], atom->nmax * PAD * sizeof(MMD_float));
+  }
+
+  integrate->dtforce = dtforce;
+  neighbor->ndanger = 0;
+
+  Timer_barrier_start(timer, TIME_TOTAL);
+  Integrate_run(integrate, atom, force, neighbor, comm, thermo, timer);
+  Timer_barrier_stop(timer, TIME_TOTAL);
+
+  time = timer->array[TIME_TOTAL];
+  MPI_Allreduce(&time, &maxtime, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  *danger = neighbor->ndanger;
+  return integrate->ntimes / maxtime;
+}
+
+/* startup auto-tuner (--autotune <steps>): trial segments of <steps> steps
+   (at least two of the longest interval) from the initial state, first over
+   skin x reneighbor interval (1/2, 1, 3/2 x skin and 1/2, 1, 2 x every of
+   the input) with the bins of the input, then over bin sizes (input,
+   cutneigh/2, cutneigh/3); the fastest configuration without dangerous
+   builds is kept, the input one if all of them had some
+   trials always rebuild at every and check the displacements (check = 2);
+   not with outer lists, incremental updates or background builds, their
+   cutoffs and rebuild schedules depend on the skin in other ways */
+
+void autotune(In *in, Atom *atom, Force *force, Neighbor *neighbor, Comm *comm,
+              Thermo *thermo, Integrate *integrate, Timer *timer, int steps)
+{
+  const int me = comm->me;
+  const int nsave = atom->nlocal;
+  const MMD_float cutforce = sqrt(force->cutforcesq);
+  const MMD_float skin0 = neighbor->cutneigh - cutforce;
+  const int every0 = neighbor->every;
+  const int check = neighbor->check;
+  const int nstat = thermo->nstat;
+  const int ntimes = integrate->ntimes;
+  const MMD_float dtforce = integrate->dtforce;      // Integrate_run divides it by the mass
+  MMD_float* xsave = (MMD_float*) malloc(MAX(nsave, 1) * PAD * sizeof(MMD_float));
+  MMD_float* vsave = (MMD_float*) malloc(MAX(nsave, 1) * PAD * sizeof(MMD_float));
+
+  const MMD_float skins[3] = {0.5 * skin0, skin0, 1.5 * skin0};
+  const int everys[3] = {MAX(every0 / 2, 1), every0, 2 * every0};
+  int nbins[3][3];
+
+  MMD_float best_cutneigh = neighbor->cutneigh;
+  int best_every = every0;
+  int best_nbin[3] = {neighbor->nbinx, neighbor->nbiny, neighbor->nbinz};
+  double best_rate = 0.0;
+  int danger;
+
+  memcpy(xsave, &atom->x[0][0], nsave * PAD * sizeof(MMD_float));
+  memcpy(vsave, &atom->v[0][0], nsave * PAD * sizeof(MMD_float));
+
+  integrate->ntimes = MAX(steps, 2 * everys[2]);
+  thermo->nstat = integrate->ntimes + 1;
+  neighbor->check = 2;
+
+  if(me == 0) printf("# Autotune: %i steps per trial\n", integrate->ntimes);
+
+  for(int is = 0; is < 3; is++)
+    for(int ie = 0; ie < 3; ie++) {
+      neighbor->cutneigh = cutforce + skins[is];
+      neighbor->every = everys[ie];
+
+      const double rate = autotune_trial(atom, force, neighbor, comm, thermo, integrate, timer, xsave, vsave, nsave, dtforce, &danger);
+
+      if(me == 0)
+        printf("# Autotune: skin %lf every %i bins %i %i %i: %lf steps/s%s\n", skins[is], everys[ie],
+               neighbor->nbinx, neighbor->nbiny, neighbor->nbinz, rate, danger ? " (dangerous builds)" : "");
+
+      if(!danger && rate > best_rate) {
+        best_rate = rate;
+        best_cutneigh = neighbor->cutneigh;
+        best_every = neighbor->every;
+      }
+    }
+
+  neighbor->cutneigh = best_cutneigh;
+  neighbor->every = best_every;
+
+  // bins of the input, then sized cutneigh/2 and cutneigh/3
+
+  nbins[0][0] = best_nbin[0];
+  nbins[0][1] = best_nbin[1];
+  nbins[0][2] = best_nbin[2];
+
+  for(int ib = 1; ib < 3; ib++) {
+    nbins[ib][0] = MAX((int)(atom->box.xprd * (ib + 1) / best_cutneigh), 1);
+    nbins[ib][1] = MAX((int)(atom->box.yprd * (ib + 1) / best_cutneigh), 1);
+    nbins[ib][2] = MAX((int)(atom->box.zprd * (ib + 1) / best_cutneigh), 1);
+  }
+
+  for(int ib = 1; ib < 3 && best_rate > 0.0; ib++) {
+    neighbor->nbinx = nbins[ib][0];
+    neighbor->nbiny = nbins[ib][1];
+    neighbor->nbinz = nbins[ib][2];
+
+    const double rate = autotune_trial(atom, force, neighbor, comm, thermo, integrate, timer, xsave, vsave, nsave, dtforce, &danger);
+
+    if(me == 0)
+      printf("# Autotune: skin %lf every %i bins %i %i %i: %lf steps/s%s\n", best_cutneigh - cutforce, best_every,
+             neighbor->nbinx, neighbor->nbiny, neighbor->nbinz, rate, danger ? " (dangerous builds)" : "");
+
+    if(!danger && rate > best_rate) {
+      best_rate = rate;
+      best_nbin[0] = nbins[ib][0];
+      best_nbin[1] = nbins[ib][1];
+      best_nbin[2] = nbins[ib][2];
+    }
+  }
+
+  // lock in the choice, the main run starts from the saved state
+
+  neighbor->cutneigh = best_cutneigh;
+  neighbor->every = best_every;
+  neighbor->nbinx = best_nbin[0];
+  neighbor->nbiny = best_nbin[1];
+  neighbor->nbinz = best_nbin[2];
+  neighbor->check = check;
+  neighbor->skin = neighbor->cutneigh - cutforce;
+  neighbor->ncalls = neighbor->nskip = neighbor->ndanger = 0;
+  thermo->nstat = nstat;
+  integrate->ntimes = ntimes;
+  in->neigh_cut = neighbor->cutneigh;
+  in->neigh_every = neighbor->every;
+
+  atom->nlocal = nsave;
+  atom->nghost = 0;
+  memcpy(&atom->x[0][0], xsave, nsave * PAD * sizeof(MMD_float));
+  memcpy(&atom->v[0][0], vsave, nsave * PAD * sizeof(MMD_float));
+
+  Comm_setup(comm, neighbor->cutneigh, atom);
+  Neighbor_setup(neighbor, atom);
+  integrate->dtforce = dtforce;
+
+  for(int i = 0; i < TIME_N; i++) timer->array[i] = 0.0;
+
+  if(me == 0)
+    printf("# Autotune: using skin %lf every %i bins %i %i %i (%lf steps/s)\n", neighbor->skin, neighbor->every,
+           neighbor->nbinx, neighbor->nbiny, neighbor->nbinz, best_rate);
+
+  free(xsave);
+  free(vsave);
+}
@@ -39,6 +39,7 @@
 #define BUFFACTOR 1.5
 #define BUFMIN 1000
 #define BUFEXTRA 100
+#define BIGCOORD 1.0e30
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 
@@ -52,14 +53,173 @@ void Comm_init(Comm *c)
   c->d_buf_recv = (MMD_float*) acc_malloc(c->maxrecv * sizeof(MMD_float));
   c->check_safeexchange = 0;
   c->do_safeexchange = 0;
+  c->exc_graph[0] = c->exc_graph[1] = c->exc_graph[2] = MPI_COMM_NULL;
   c->maxthreads = 0;
   c->maxnlocal = 0;
+  c->maxswap = 0;
+  c->direct = 0;
+  c->ghost_sort = 0;
+  c->recvlist = NULL;
+  c->maxrecvlist = 0;
+  c->nplan = 0;
+}
+
+/* persistent requests of every swap with another proc, set up after borders
+   (and the ghost sort): peers, sizes and buffer parts stay fixed until the
+   next borders, so each communicate only starts and waits (tag = kind of
+   traffic + swap)
+   forward positions are received straight into the ghost slots of x and sent
+   straight from x (indexed blocks of the send list) unless the swap shifts
+   them across the periodic boundary, then they are packed as before */
+
+static void Comm_free_plan(Comm *comm)
+{
+  for(int i = 0; i < comm->nplan; i++)
+    if(comm->requests[i] != MPI_REQUEST_NULL) MPI_Request_free(&comm->requests[i]);
+
+  for(int iswap = 0; iswap < comm->nplan / PLAN_N; iswap++) {
+    if(comm->sendtype[iswap] != MPI_DATATYPE_NULL) MPI_Type_free(&comm->sendtype[iswap]);
+    if(comm->recvtype[iswap] != MPI_DATATYPE_NULL) MPI_Type_free(&comm->recvtype[iswap]);
+  }
+
+  comm->nplan = 0;
+}
+
+static void Comm_build_plan(Comm *comm, Atom *atom)
+{
+  MPI_Datatype type = sizeof(MMD_float) == 4 ? MPI_FLOAT : MPI_DOUBLE;
+  MMD_float* const x = atom->d_x;
+  int maxdisp = 0;
+
+  Comm_free_plan(comm);
+
+  for(int iswap = 0; iswap < comm->nswap; iswap++)
+    maxdisp = MAX(maxdisp, MAX(comm->sendnum[iswap], comm->recvnum[iswap]));
+
+  int* disp = (int*) malloc((maxdisp + 1) * sizeof(int));
+
+  for(int iswap = 0; iswap < comm->nswap; iswap++) {
+    MPI_Request* const request = &comm->requests[PLAN_N * iswap];
+    const int tag = PLAN_N * iswap;
+    const int* const recvlist = Comm_recvlist(comm, iswap);
+
+    comm->sendtype[iswap] = MPI_DATATYPE_NULL;
+    comm->recvtype[iswap] = MPI_DATATYPE_NULL;
+
+    if(comm->sendproc[iswap] == comm->me) {
+      for(int k = 0; k < PLAN_N; k++) request[k] = MPI_REQUEST_NULL;
+
+      continue;
+    }
+
+    if(recvlist || PAD != 3) {
+      for(int k = 0; k < comm->recvnum[iswap]; k++)
+        disp[k] = (recvlist ? recvlist[k] : comm->firstrecv[iswap] + k) * PAD;
+
+      MPI_Type_create_indexed_block(comm->recvnum[iswap], 3, disp, type, &comm->recvtype[iswap]);
+      MPI_Type_commit(&comm->recvtype[iswap]);
+      MPI_Recv_init(x, 1, comm->recvtype[iswap],
+                    comm->recvproc[iswap], tag + PLAN_FWD, MPI_COMM_WORLD, &request[PLAN_FWD]);
+    } else
+      MPI_Recv_init(&x[comm->firstrecv[iswap] * PAD], comm->comm_recv_size[iswap], type,
+                    comm->recvproc[iswap], tag + PLAN_FWD, MPI_COMM_WORLD, &request[PLAN_FWD]);
+
+    if(!comm->pbc_any[iswap]) {
+      for(int k = 0; k < comm->sendnum[iswap]; k++)
+        disp[k] = comm->sendlist[iswap][k] * PAD;
+
+      MPI_Type_create_indexed_block(comm->sendnum[iswap], 3, disp, type, &comm->sendtype[iswap]);
+      MPI_Type_commit(&comm->sendtype[iswap]);
+      MPI_Send_init(x, 1, comm->sendtype[iswap],
+                    comm->sendproc[iswap], tag + PLAN_FWD, MPI_COMM_WORLD, &request[PLAN_FWD + 1]);
+    } else
+      MPI_Send_init(&comm->d_buf_send[comm->send_offset[iswap]], comm->comm_send_size[iswap], type,
+                    comm->sendproc[iswap], tag + PLAN_FWD, MPI_COMM_WORLD, &request[PLAN_FWD + 1]);
+
+    MPI_Recv_init(&comm->buf_recv[comm->buf_offset[iswap]], comm->reverse_recv_size[iswap], type,
+                  comm->sendproc[iswap], tag + PLAN_REV, MPI_COMM_WORLD, &request[PLAN_REV]);
+    MPI_Send_init(&comm->buf_send[comm->buf_offset[iswap]], comm->reverse_send_size[iswap], type,
+                  comm->recvproc[iswap], tag + PLAN_REV, MPI_COMM_WORLD, &request[PLAN_REV + 1]);
+
+    MPI_Recv_init(&comm->buf_recv[comm->buf_offset[iswap]], comm->recvnum[iswap], type,
+                  comm->recvproc[iswap], tag + PLAN_FP, MPI_COMM_WORLD, &request[PLAN_FP]);
+    MPI_Send_init(&comm->buf_send[comm->buf_offset[iswap]], comm->sendnum[iswap], type,
+                  comm->sendproc[iswap], tag + PLAN_FP, MPI_COMM_WORLD, &request[PLAN_FP + 1]);
+  }
+
+  free(disp);
+
+  comm->nplan = PLAN_N * comm->nswap;
 }
 
 //void Comm_destroy(Comm *c)
 //{
 //}
 
+/* direct halo: one swap for every neighbor box within need in each dim
+   (26 for need = 1), in it I send the local atoms within cutneigh of that box
+   (slab bounds per dim, periodic image shifted), so no swap forwards ghosts
+   and all of them can be in flight at once
+   the proc at +offset gets my atoms, the one at -offset sends me its atoms */
+
+static void Comm_setup_direct(Comm *comm, MMD_float cutneigh, Atom *atom, MPI_Comm cartesian, int* myloc)
+{
+  MMD_float prd[3], boxlo[3], boxhi[3];
+  int o[3], coords[3];
+
+  prd[0] = atom->box.xprd;
+  prd[1] = atom->box.yprd;
+  prd[2] = atom->box.zprd;
+  boxlo[0] = atom->box.xlo;
+  boxlo[1] = atom->box.ylo;
+  boxlo[2] = atom->box.zlo;
+  boxhi[0] = atom->box.xhi;
+  boxhi[1] = atom->box.yhi;
+  boxhi[2] = atom->box.zhi;
+
+  comm->nswap = 0;
+
+  for(o[2] = -comm->need[2]; o[2] <= comm->need[2]; o[2]++)
+    for(o[1] = -comm->need[1]; o[1] <= comm->need[1]; o[1]++)
+      for(o[0] = -comm->need[0]; o[0] <= comm->need[0]; o[0]++) {
+        if(o[0] == 0 && o[1] == 0 && o[2] == 0) continue;
+
+        const int iswap = comm->nswap++;
+        int flag[3];
+
+        for(int d = 0; d < 3; d++) {
+          const MMD_float len = prd[d] / comm->procgrid[d];
+          const int loc = myloc[d] + o[d];
+
+          // images across the periodic boundary: -1 per box length I wrap over
+
+          flag[d] = loc >= 0 ? -(loc / comm->procgrid[d]) : (comm->procgrid[d] - 1 - loc) / comm->procgrid[d];
+
+          MMD_float lo = -BIGCOORD;
+          MMD_float hi = BIGCOORD;
+
+          if(o[d] > 0) lo = boxhi[d] - cutneigh + (o[d] - 1) * len;
+
+          if(o[d] < 0) hi = boxlo[d] + cutneigh + (o[d] + 1) * len;
+
+          comm->slablo[3 * iswap + d] = lo;
+          comm->slabhi[3 * iswap + d] = hi;
+          coords[d] = loc;
+        }
+
+        MPI_Cart_rank(cartesian, coords, &comm->sendproc[iswap]);
+
+        for(int d = 0; d < 3; d++) coords[d] = myloc[d] - o[d];
+
+        MPI_Cart_rank(cartesian, coords, &comm->recvproc[iswap]);
+
+        comm->pbc_flagx[iswap] = flag[0];
+        comm->pbc_flagy[iswap] = flag[1];
+        comm->pbc_flagz[iswap] = flag[2];
+        comm->pbc_any[iswap] = flag[0] || flag[1] || flag[2];
+      }
+}
+
 /* setup spatial-decomposition communication patterns */
 
 int Comm_setup(Comm *comm, MMD_float cutneigh, Atom *atom)
@@ -156,12 +316,58 @@ int Comm_setup(Comm *comm, MMD_float cutneigh, Atom *atom)
   comm->need[1] = (int)(cutneigh * comm->procgrid[1] / prd[1] + 1);
   comm->need[2] = (int)(cutneigh * comm->procgrid[2] / prd[2] + 1);
 
-  /* alloc comm memory */
+  /* alloc comm memory (free the one of an earlier setup, see autotune) */
+
+  if(comm->maxswap) {
+    Comm_free_plan(comm);
+    free(comm->slablo);
+    free(comm->slabhi);
+    free(comm->pbc_any);
+    free(comm->pbc_flagx);
+    free(comm->pbc_flagy);
+    free(comm->pbc_flagz);
+    free(comm->sendproc);
+    free(comm->recvproc);
+    free(comm->sendproc_exc);
+    free(comm->recvproc_exc);
+    free(comm->sendnum);
+    free(comm->recvnum);
+    free(comm->comm_send_size);
+    free(comm->comm_recv_size);
+    free(comm->reverse_send_size);
+    free(comm->reverse_recv_size);
+    free(comm->firstrecv);
+    free(comm->maxsendlist);
+    free(comm->sendlocal);
+    free(comm->started);
+    free(comm->send_offset);
+    free(comm->recv_offset);
+    free(comm->buf_offset);
+    free(comm->requests);
+    free(comm->sendtype);
+    free(comm->recvtype);
+    free(comm->exc_sendcounts);
+    free(comm->exc_sdispls);
+    free(comm->exc_recvcounts);
+    free(comm->exc_rdispls);
+
+    for(i = 0; i < comm->maxswap; i++) free(comm->sendlist[i]);
+
+    free(comm->sendlist);
+  }
+
+  // the direct halo has a swap for every neighbor box (the safe exchange
+  // still indexes the swaps of the dimension sweep)
 
   int maxswap = 2 * (comm->need[0] + comm->need[1] + comm->need[2]);
 
-  comm->slablo = (MMD_float*) malloc(maxswap * sizeof(MMD_float));
-  comm->slabhi = (MMD_float*) malloc(maxswap * sizeof(MMD_float));
+  if(comm->direct)
+    maxswap = MAX(maxswap, (2 * comm->need[0] + 1) * (2 * comm->need[1] + 1) * (2 * comm->need[2] + 1) - 1);
+
+  comm->maxswap = maxswap;
+
+  comm->slablo = (MMD_float*) malloc(3 * maxswap * sizeof(MMD_float));
+  comm->slabhi = (MMD_float*) malloc(3 * maxswap * sizeof(MMD_float));
   comm->pbc_any = (int*) malloc(maxswap * sizeof(int));
   comm->pbc_flagx = (int*) malloc(maxswap * sizeof(int));
   comm->pbc_flagy = (int*) malloc(maxswap * sizeof(int));
@@ -176,6 +382,18 @@ int Comm_setup(Comm *comm, MMD_float cutneigh, Atom *atom)
   comm->comm_recv_size = (int*) malloc(maxswap * sizeof(int));
   comm->reverse_send_size = (int*) malloc(maxswap * sizeof(int));
   comm->reverse_recv_size = (int*) malloc(maxswap * sizeof(int));
+  comm->sendlocal = (int*) malloc(maxswap * sizeof(int));
+  comm->started = (int*) malloc(maxswap * sizeof(int));
+  comm->send_offset = (int*) malloc(maxswap * sizeof(int));
+  comm->recv_offset = (int*) malloc(maxswap * sizeof(int));
+  comm->buf_offset = (int*) malloc(maxswap * sizeof(int));
+  comm->requests = (MPI_Request*) malloc(PLAN_N * maxswap * sizeof(MPI_Request));
+  comm->sendtype = (MPI_Datatype*) malloc(maxswap * sizeof(MPI_Datatype));
+  comm->recvtype = (MPI_Datatype*) malloc(maxswap * sizeof(MPI_Datatype));
+  comm->exc_sendcounts = (int*) malloc(maxswap * sizeof(int));
+  comm->exc_sdispls = (int*) malloc(maxswap * sizeof(int));
+  comm->exc_recvcounts = (int*) malloc(maxswap * sizeof(int));
+  comm->exc_rdispls = (int*) malloc(maxswap * sizeof(int));
   int iswap = 0;
 
   for(int idim = 0; idim < 3; idim++)
@@ -184,7 +402,34 @@ int Comm_setup(Comm *comm, MMD_float cutneigh, Atom *atom)
       MPI_Cart_shift(cartesian, idim, i, &comm->recvproc_exc[iswap + 1], &comm->recvproc_exc[iswap]);
     }
 
-  MPI_Comm_free(&cartesian);
+  /* safe exchange: one distributed graph per dimension, the atoms leaving in
+     that dim go to every proc within reach (sendproc_exc of the first
+     procgrid - 1 swaps, no proc twice) and come from recvproc_exc, in the
+     order of the swaps
+     all edges get weight 1 (MPI_UNWEIGHTED is a sentinel address that reads
+     as an empty array to the compiler's bounds checks) */
+
+  int* weights = (int*) malloc(maxswap * sizeof(int));
+
+  for(i = 0; i < maxswap; i++) weights[i] = 1;
+
+  iswap = 0;
+
+  for(idim = 0; idim < 3; idim++) {
+    if(comm->exc_graph[idim] != MPI_COMM_NULL) MPI_Comm_free(&comm->exc_graph[idim]);
+
+    comm->exc_degree[idim] = MIN(2 * comm->need[idim], comm->procgrid[idim] - 1);
+
+    if(comm->do_safeexchange && comm->exc_degree[idim] > 0)
+      MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+                                     comm->exc_degree[idim], &comm->recvproc_exc[iswap], weights,
+                                     comm->exc_degree[idim], &comm->sendproc_exc[iswap], weights,
+                                     MPI_INFO_NULL, 0, &comm->exc_graph[idim]);
+
+    iswap += 2 * comm->need[idim];
+  }
+
+  free(weights);
 
   comm->firstrecv = (int*) malloc(maxswap * sizeof(int));
   comm->maxsendlist = (int*) malloc(maxswap * sizeof(int));
@@ -196,6 +441,14 @@ int Comm_setup(Comm *comm, MMD_float cutneigh, Atom *atom)
   for(i = 0; i < maxswap; i++)
     comm->sendlist[i] = (int*) malloc(BUFMIN * sizeof(int));
 
+  if(comm->direct) {
+    Comm_setup_direct(comm, cutneigh, atom, cartesian, myloc);
+    MPI_Comm_free(&cartesian);
+    return 0;
+  }
+
+  MPI_Comm_free(&cartesian);
+
   /* setup 4 parameters for each exchange: (spart,rpart,slablo,slabhi)
      sendproc(nswap) = proc to send to at each swap
      recvproc(nswap) = proc to recv from at each swap
@@ -276,63 +529,74 @@ int Comm_setup(Comm *comm, MMD_float cutneigh, Atom *atom)
   return 0;
 }
 
-/* communication of atom info every timestep */
+/* slots of the atoms received in a swap, NULL if they are contiguous from firstrecv */
+
+int* Comm_recvlist(Comm *comm, int iswap)
+{
+  if(!comm->ghost_sort) return NULL;
+
+  return &comm->recvlist[comm->firstrecv[iswap] - comm->firstrecv[0]];
+}
+
+/* communication of atom info every timestep
+   swaps with another proc receive straight into x (plan from borders), only
+   the swaps across the periodic boundary and the ones with myself pack
+   swaps without ghosts in the send list are posted together (all swaps of
+   the direct halo), the others follow in order */
 
 void Comm_communicate(Comm *comm, Atom *atom)
 {
+  Comm_communicate_start(comm, atom);
+  Comm_communicate_finish(comm, atom);
+}
 
-  int iswap;
-  int pbc_flags[4];
-  MMD_float* buf;
-  MPI_Request request;
-  MPI_Status status;
+/* split communicate: communicate_start posts the swaps whose send lists hold
+   only local atoms (their data is final once the positions are integrated),
+   communicate_finish completes them and does the other swaps in order, which
+   need the ghosts of earlier swaps
+   every swap has its own part of the buffers and its own tags, so the swaps
+   can be in flight together */
 
-  for(iswap = 0; iswap < comm->nswap; iswap++) {
+static void Comm_communicate_swap(Comm *comm, Atom *atom, int iswap)
+{
+  int pbc_flags[4];
+  MMD_float* buf = &comm->d_buf_send[comm->send_offset[iswap]];
+  const int remote = comm->sendproc[iswap] != comm->me;
 
-    /* pack buffer */
+  pbc_flags[0] = comm->pbc_any[iswap];
+  pbc_flags[1] = comm->pbc_flagx[iswap];
+  pbc_flags[2] = comm->pbc_flagy[iswap];
+  pbc_flags[3] = comm->pbc_flagz[iswap];
 
-    pbc_flags[0] = comm->pbc_any[iswap];
-    pbc_flags[1] = comm->pbc_flagx[iswap];
-    pbc_flags[2] = comm->pbc_flagy[iswap];
-    pbc_flags[3] = comm->pbc_flagz[iswap];
+  if(!remote || comm->sendtype[iswap] == MPI_DATATYPE_NULL)
+    Atom_pack_comm(atom, comm->sendnum[iswap], comm->sendlist[iswap], buf, pbc_flags);
 
-    //
-    //printf("C1\n");
-    Atom_pack_comm(atom, comm->sendnum[iswap], comm->sendlist[iswap], comm->d_buf_send, pbc_flags);
-    //printf("C2\n");
+  if(remote)
+    MPI_Startall(2, &comm->requests[PLAN_N * iswap + PLAN_FWD]);
+  else
+    Atom_unpack_comm(atom, comm->recvnum[iswap], comm->firstrecv[iswap], Comm_recvlist(comm, iswap), buf);
+}
 
-    //
+void Comm_communicate_start(Comm *comm, Atom *atom)
+{
+  int iswap;
 
-    /* exchange with another proc
-       if self, set recv buffer to send buffer */
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    comm->started[iswap] = comm->sendlocal[iswap];
 
-    if(comm->sendproc[iswap] != comm->me) {
-      
-      {
-        if(sizeof(MMD_float) == 4) {
-          MPI_Irecv(comm->d_buf_recv, comm->comm_recv_size[iswap], MPI_FLOAT,
-          comm->recvproc[iswap], 0, MPI_COMM_WORLD, &request);
-          MPI_Send(comm->d_buf_send, comm->comm_send_size[iswap], MPI_FLOAT,
-          comm->sendproc[iswap], 0, MPI_COMM_WORLD);
-        } else {
-          MPI_Irecv(comm->d_buf_recv, comm->comm_recv_size[iswap], MPI_DOUBLE,
-          comm->recvproc[iswap], 0, MPI_COMM_WORLD, &request);
-          MPI_Send(comm->d_buf_send, comm->comm_send_size[iswap], MPI_DOUBLE,
-          comm->sendproc[iswap], 0, MPI_COMM_WORLD);
-        }
+    if(comm->started[iswap]) Comm_communicate_swap(comm, atom, iswap);
+  }
+}
 
-        MPI_Wait(&request, &status);
-      }
-      buf = comm->d_buf_recv;
-    } else buf = comm->d_buf_send;
+void Comm_communicate_finish(Comm *comm, Atom *atom)
+{
+  int iswap;
 
-    
-    /* unpack buffer */
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    if(!comm->started[iswap]) Comm_communicate_swap(comm, atom, iswap);
 
-    //printf("C3\n");
-    Atom_unpack_comm(atom, comm->recvnum[iswap], comm->firstrecv[iswap], buf);
-    //printf("C4\n");
-    //
+    if(comm->sendproc[iswap] != comm->me)
+      MPI_Waitall(2, &comm->requests[PLAN_N * iswap + PLAN_FWD], MPI_STATUSES_IGNORE);
   }
 }
 
@@ -342,45 +606,54 @@ void Comm_reverse_communicate(Comm *comm, Atom *atom)
 {
   int iswap;
   MMD_float* buf;
-  MPI_Request request;
-  MPI_Status status;
+
+  /* direct halo: every swap sends back to local atoms only,
+     so all of them are in flight at once */
+
+  if(comm->direct) {
+    for(iswap = 0; iswap < comm->nswap; iswap++) {
+      Atom_pack_reverse(atom, comm->recvnum[iswap], comm->firstrecv[iswap], Comm_recvlist(comm, iswap),
+                        &comm->buf_send[comm->buf_offset[iswap]]);
+
+      if(comm->sendproc[iswap] != comm->me)
+        MPI_Startall(2, &comm->requests[PLAN_N * iswap + PLAN_REV]);
+    }
+
+    for(iswap = 0; iswap < comm->nswap; iswap++) {
+      buf = &comm->buf_send[comm->buf_offset[iswap]];
+
+      if(comm->sendproc[iswap] != comm->me) {
+        MPI_Waitall(2, &comm->requests[PLAN_N * iswap + PLAN_REV], MPI_STATUSES_IGNORE);
+        buf = &comm->buf_recv[comm->buf_offset[iswap]];
+      }
+
+      Atom_unpack_reverse(atom, comm->sendnum[iswap], comm->sendlist[iswap], buf);
+    }
+
+    return;
+  }
 
   for(iswap = comm->nswap - 1; iswap >= 0; iswap--) {
 
     /* pack buffer */
 
-    // 
-    Atom_pack_reverse(atom, comm->recvnum[iswap], comm->firstrecv[iswap], comm->buf_send);
+    buf = &comm->buf_send[comm->buf_offset[iswap]];
+    Atom_pack_reverse(atom, comm->recvnum[iswap], comm->firstrecv[iswap], Comm_recvlist(comm, iswap), buf);
 
-    // 
-    /* exchange with another proc
+    /* exchange with another proc (requests of the plan from borders)
        if self, set recv buffer to send buffer */
 
     if(comm->sendproc[iswap] != comm->me) {
+      MPI_Request* const request = &comm->requests[PLAN_N * iswap + PLAN_REV];
 
-      
-      {
-        if(sizeof(MMD_float) == 4) {
-          MPI_Irecv(comm->buf_recv, comm->reverse_recv_size[iswap], MPI_FLOAT,
-          comm->sendproc[iswap], 0, MPI_COMM_WORLD, &request);
-          MPI_Send(comm->buf_send, comm->reverse_send_size[iswap], MPI_FLOAT,
-          comm->recvproc[iswap], 0, MPI_COMM_WORLD);
-        } else {
-          MPI_Irecv(comm->buf_recv, comm->reverse_recv_size[iswap], MPI_DOUBLE,
-          comm->sendproc[iswap], 0, MPI_COMM_WORLD, &request);
-          MPI_Send(comm->buf_send, comm->reverse_send_size[iswap], MPI_DOUBLE,
-          comm->recvproc[iswap], 0, MPI_COMM_WORLD);
-        }
-        MPI_Wait(&request, &status);
-      }
-      buf = comm->buf_recv;
-    } else buf = comm->buf_send;
+      MPI_Startall(2, request);
+      MPI_Waitall(2, request, MPI_STATUSES_IGNORE);
+      buf = &comm->buf_recv[comm->buf_offset[iswap]];
+    }
 
     /* unpack buffer */
 
-    
     Atom_unpack_reverse(atom, comm->sendnum[iswap], comm->sendlist[iswap], buf);
-    // 
   }
 }
 
@@ -650,28 +923,22 @@ void Comm_exchange(Comm *comm, Atom *atom)
 
 void Comm_exchange_all(Comm *comm, Atom *atom)
 {
-  int i, m, n, idim, nsend, nrecv, nrecv1, nrecv2, nlocal;
+  int i, k, m, n, idim, nsend, nrecv, nlocal;
   MMD_float lo, hi, value;
   MMD_float** x;
-
-  MPI_Request request;
-  MPI_Status status;
+  MPI_Datatype type = sizeof(MMD_float) == 4 ? MPI_FLOAT : MPI_DOUBLE;
 
   /* enforce PBC */
 
   Atom_pbc(atom);
 
   /* loop over dimensions */
-  int iswap = 0;
 
   for(idim = 0; idim < 3; idim++) {
 
     /* only exchange if more than one proc in this dimension */
 
-    if(comm->procgrid[idim] == 1) {
-      iswap += 2 * comm->need[idim];
-      continue;
-    }
+    if(comm->procgrid[idim] == 1) continue;
 
     /* fill buffer with atoms leaving my box
     *        when atom is deleted, fill it in with last atom */
@@ -705,48 +972,223 @@ void Comm_exchange_all(Comm *comm, Atom *atom)
 
     atom->nlocal = nlocal;
 
-    /* send/recv atoms in both directions
-    *        only if neighboring procs are different */
-    for(int ineed = 0; ineed < 2 * comm->need[idim]; ineed += 1) {
-      if(ineed < comm->procgrid[idim] - 1) {
-        MPI_Send(&nsend, 1, MPI_INT, comm->sendproc_exc[iswap], 0, MPI_COMM_WORLD);
-        MPI_Recv(&nrecv, 1, MPI_INT, comm->recvproc_exc[iswap], 0, MPI_COMM_WORLD, &status);
+    /* send the leaving atoms to all procs within reach in this dimension
+       counts and atoms in one neighborhood collective each */
 
-        if(nrecv > comm->maxrecv) Comm_growrecv(comm, nrecv);
+    const int degree = comm->exc_degree[idim];
 
-        if(sizeof(MMD_float) == 4) {
-          MPI_Irecv(comm->buf_recv, nrecv, MPI_FLOAT, comm->recvproc_exc[iswap], 0,
-                    MPI_COMM_WORLD, &request);
-          MPI_Send(comm->buf_send, nsend, MPI_FLOAT, comm->sendproc_exc[iswap], 0, MPI_COMM_WORLD);
-        } else {
-          MPI_Irecv(comm->buf_recv, nrecv, MPI_DOUBLE, comm->recvproc_exc[iswap], 0,
-                    MPI_COMM_WORLD, &request);
-          MPI_Send(comm->buf_send, nsend, MPI_DOUBLE, comm->sendproc_exc[iswap], 0, MPI_COMM_WORLD);
-        }
+    for(k = 0; k < degree; k++) {
+      comm->exc_sendcounts[k] = nsend;
+      comm->exc_sdispls[k] = 0;
+    }
 
-        MPI_Wait(&request, &status);
+    MPI_Neighbor_alltoall(comm->exc_sendcounts, 1, MPI_INT, comm->exc_recvcounts, 1, MPI_INT,
+                          comm->exc_graph[idim]);
+
+    nrecv = 0;
 
-        /* check incoming atoms to see if they are in my box
-        *        if they are, add to my list */
+    for(k = 0; k < degree; k++) {
+      comm->exc_rdispls[k] = nrecv;
+      nrecv += comm->exc_recvcounts[k];
+    }
 
-        n = atom->nlocal;
-        m = 0;
+    if(nrecv > comm->maxrecv) Comm_growrecv(comm, nrecv);
 
-        while(m < nrecv) {
-          value = comm->buf_recv[m + idim];
+    MPI_Neighbor_alltoallv(comm->buf_send, comm->exc_sendcounts, comm->exc_sdispls, type,
+                           comm->buf_recv, comm->exc_recvcounts, comm->exc_rdispls, type,
+                           comm->exc_graph[idim]);
 
-          if(value >= lo && value < hi)
-            m += Atom_unpack_exchange(atom, n++, &comm->buf_recv[m]);
-          else m += Atom_skip_exchange(atom, &comm->buf_recv[m]);
-        }
+    /* check incoming atoms to see if they are in my box
+    *        if they are, add to my list */
+
+    n = atom->nlocal;
+    m = 0;
+
+    while(m < nrecv) {
+      value = comm->buf_recv[m + idim];
+
+      if(value >= lo && value < hi)
+        m += Atom_unpack_exchange(atom, n++, &comm->buf_recv[m]);
+      else m += Atom_skip_exchange(atom, &comm->buf_recv[m]);
+    }
+
+    atom->nlocal = n;
+  }
+}
+
+/* sort ghosts:
+   reorder the ghosts of the last borders by bin, so the ghosts near one
+   boundary atom are close in memory, and keep the slot of every received
+   ghost in recvlist, which communicate and reverse_communicate use instead
+   of the contiguous range from firstrecv
+   sendlist entries that are ghosts themselves are moved to the new slots
+*/
+
+void Comm_sort_ghosts(Comm *comm, Atom *atom, struct Neighbor_s *neighbor)
+{
+  const int nlocal = atom->nlocal;
+
+  if(atom->nghost > comm->maxrecvlist) {
+    if(comm->recvlist) free(comm->recvlist);
+
+    comm->maxrecvlist = atom->nghost * BUFFACTOR;
+    comm->recvlist = (int*) malloc(comm->maxrecvlist * sizeof(int));
+  }
+
+  Atom_sort_ghosts(atom, neighbor, comm->recvlist);
+
+  for(int iswap = 0; iswap < comm->nswap; iswap++) {
+    int* const list = comm->sendlist[iswap];
+
+    #pragma omp parallel for
+    for(int k = 0; k < comm->sendnum[iswap]; k++)
+      if(list[k] >= nlocal) list[k] = comm->recvlist[list[k] - nlocal];
+  }
+
+  Comm_build_plan(comm, atom);
+}
 
-        atom->nlocal = n;
+/* buffer parts of the swaps (forward traffic in the device buffers, reverse
+   and EAM fp traffic in the host buffers) and swaps without ghosts in the
+   send list for the split communicate */
+
+static void Comm_borders_plan(Comm *comm, Atom *atom)
+{
+  int i, iswap;
+  int sendtotal = 0;
+  int recvtotal = 0;
+  int hosttotal = 0;
+
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    comm->send_offset[iswap] = sendtotal;
+    comm->recv_offset[iswap] = recvtotal;
+    comm->buf_offset[iswap] = hosttotal;
+    sendtotal += comm->comm_send_size[iswap];
+    recvtotal += comm->comm_recv_size[iswap];
+    hosttotal += MAX(comm->reverse_send_size[iswap], comm->reverse_recv_size[iswap]);
+
+    comm->sendlocal[iswap] = 1;
+
+    for(i = 0; i < comm->sendnum[iswap]; i++)
+      if(comm->sendlist[iswap][i] >= atom->nlocal) {
+        comm->sendlocal[iswap] = 0;
+        break;
       }
+  }
+
+  if(MAX(sendtotal, hosttotal) > comm->maxsend) Comm_growsend(comm, MAX(sendtotal, hosttotal));
+
+  if(MAX(recvtotal, hosttotal) > comm->maxrecv) Comm_growrecv(comm, MAX(recvtotal, hosttotal));
+
+  // with ghost sort the plan follows the new slots (Comm_sort_ghosts)
+
+  if(!comm->ghost_sort) Comm_build_plan(comm, atom);
+}
+
+/* borders of the direct halo: the send lists of all swaps hold local atoms
+   only, so the counts of all swaps go out in one round and the atoms in a
+   second one, the ghosts are unpacked in swap order */
+
+static void Comm_borders_direct(Comm *comm, Atom *atom)
+{
+  MPI_Datatype type = sizeof(MMD_float) == 4 ? MPI_FLOAT : MPI_DOUBLE;
+  MPI_Request* const request = comm->requests;
+  MMD_float** x = atom->x;
+  const int nlocal = atom->nlocal;
+  int iswap, nreq, sendtotal, recvtotal;
+
+  Comm_free_plan(comm);
+
+  atom->nghost = 0;
+
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    const MMD_float* const lo = &comm->slablo[3 * iswap];
+    const MMD_float* const hi = &comm->slabhi[3 * iswap];
+    int nsend = 0;
+
+    for(int i = 0; i < nlocal; i++)
+      if(x[i][0] >= lo[0] && x[i][0] <= hi[0] &&
+         x[i][1] >= lo[1] && x[i][1] <= hi[1] &&
+         x[i][2] >= lo[2] && x[i][2] <= hi[2]) {
+        if(nsend >= comm->maxsendlist[iswap]) Comm_growlist(comm, iswap, nsend + 1);
+
+        comm->sendlist[iswap][nsend++] = i;
+      }
+
+    comm->sendnum[iswap] = nsend;
+  }
+
+  /* # of atoms of every swap */
+
+  nreq = 0;
+
+  for(iswap = 0; iswap < comm->nswap; iswap++)
+    if(comm->sendproc[iswap] != comm->me) {
+      MPI_Irecv(&comm->recvnum[iswap], 1, MPI_INT, comm->recvproc[iswap], iswap, MPI_COMM_WORLD, &request[nreq++]);
+      MPI_Isend(&comm->sendnum[iswap], 1, MPI_INT, comm->sendproc[iswap], iswap, MPI_COMM_WORLD, &request[nreq++]);
+    } else
+      comm->recvnum[iswap] = comm->sendnum[iswap];
+
+  MPI_Waitall(nreq, request, MPI_STATUSES_IGNORE);
+
+  sendtotal = recvtotal = 0;
 
-      iswap += 1;
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    comm->send_offset[iswap] = sendtotal;
+    comm->recv_offset[iswap] = recvtotal;
+    sendtotal += comm->sendnum[iswap] * atom->border_size;
+    recvtotal += comm->recvnum[iswap] * atom->border_size;
+  }
+
+  if(sendtotal > comm->maxsend) Comm_growsend(comm, sendtotal);
+
+  if(recvtotal > comm->maxrecv) Comm_growrecv(comm, recvtotal);
+
+  /* atoms of every swap, self swaps read their part of the send buffer */
+
+  nreq = 0;
+
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    int pbc_flags[4];
+    MMD_float* const buf = &comm->buf_send[comm->send_offset[iswap]];
 
+    pbc_flags[0] = comm->pbc_any[iswap];
+    pbc_flags[1] = comm->pbc_flagx[iswap];
+    pbc_flags[2] = comm->pbc_flagy[iswap];
+    pbc_flags[3] = comm->pbc_flagz[iswap];
+
+    for(int k = 0; k < comm->sendnum[iswap]; k++)
+      Atom_pack_border(atom, comm->sendlist[iswap][k], &buf[k * atom->border_size], pbc_flags);
+
+    if(comm->sendproc[iswap] != comm->me) {
+      MPI_Irecv(&comm->buf_recv[comm->recv_offset[iswap]], comm->recvnum[iswap] * atom->border_size, type,
+                comm->recvproc[iswap], iswap, MPI_COMM_WORLD, &request[nreq++]);
+      MPI_Isend(buf, comm->sendnum[iswap] * atom->border_size, type,
+                comm->sendproc[iswap], iswap, MPI_COMM_WORLD, &request[nreq++]);
     }
   }
+
+  MPI_Waitall(nreq, request, MPI_STATUSES_IGNORE);
+
+  /* unpack buffers and set all pointers & counters */
+
+  for(iswap = 0; iswap < comm->nswap; iswap++) {
+    const int nsend = comm->sendnum[iswap];
+    const int nrecv = comm->recvnum[iswap];
+    const int n = atom->nlocal + atom->nghost;
+    MMD_float* const buf = comm->sendproc[iswap] != comm->me ?
+                           &comm->buf_recv[comm->recv_offset[iswap]] : &comm->buf_send[comm->send_offset[iswap]];
+
+    for(int i = 0; i < nrecv; i++)
+      Atom_unpack_border(atom, n + i, &buf[i * atom->border_size]);
+
+    comm->comm_send_size[iswap] = nsend * atom->comm_size;
+    comm->comm_recv_size[iswap] = nrecv * atom->comm_size;
+    comm->reverse_send_size[iswap] = nrecv * atom->reverse_size;
+    comm->reverse_recv_size[iswap] = nsend * atom->reverse_size;
+    comm->firstrecv[iswap] = n;
+    atom->nghost += nrecv;
+  }
 }
 
 /* borders:
@@ -767,6 +1209,12 @@ void Comm_borders(Comm *comm, Atom *atom)
   MPI_Request request;
   MPI_Status status;
 
+  if(comm->direct) {
+    Comm_borders_direct(comm, atom);
+    Comm_borders_plan(comm, atom);
+    return;
+  }
+
   /* erase all ghost atoms */
 
   atom->nghost = 0;
@@ -940,19 +1388,7 @@ void Comm_borders(Comm *comm, Atom *atom)
     }
   }
 
-  /* insure buffers are large enough for reverse comm */
-
-  int max1, max2;
-  max1 = max2 = 0;
-
-  for(iswap = 0; iswap < comm->nswap; iswap++) {
-    max1 = MAX(max1, comm->reverse_send_size[iswap]);
-    max2 = MAX(max2, comm->reverse_recv_size[iswap]);
-  }
-
-  if(max1 > comm->maxsend) Comm_growsend(comm, max1);
-
-  if(max2 > comm->maxrecv) Comm_growrecv(comm, max2);
+  Comm_borders_plan(comm, atom);
 }
 
 /* realloc the size of the send buffer as needed with BUFFACTOR & BUFEXTRA */
@@ -32,10 +32,20 @@
 #ifndef COMM_H
 #define COMM_H
 
+#include "mpi.h"
 #include "atom.h"
 #include "threadData.h"
 #include "timer.h"
 
+struct Neighbor_s;
+
+// persistent requests of a swap: recv and send of the forward, reverse and EAM fp traffic
+
+#define PLAN_FWD 0
+#define PLAN_REV 2
+#define PLAN_FP  4
+#define PLAN_N   6
+
 typedef struct
 {
     int me;                           // my proc ID
@@ -55,6 +65,21 @@ typedef struct
     int* firstrecv;                   // where to put 1st recv atom in each swap
     int** sendlist;                   // list of atoms to send in each swap
     int* maxsendlist;
+    int maxswap;                      // allocated size of the swap arrays
+    int direct;                       // 1: one swap per neighbor box, all in flight at once
+
+    int ghost_sort;                   // 1: ghosts reordered by bin after borders
+    int* recvlist;                    // slot of every received ghost (swap order) if sorted
+    int maxrecvlist;
+
+    int* sendlocal;                   // 1 if the swap sends no ghosts (goes out in communicate_start)
+    int* started;                     // swap posted by communicate_start
+    int* send_offset, *recv_offset;   // part of the device buffers of each swap (forward)
+    int* buf_offset;                  // part of the host buffers of each swap (reverse, EAM fp)
+    MPI_Request* requests;            // persistent recv and send requests, PLAN_N per swap
+    MPI_Datatype* sendtype;           // ghost positions sent straight from x (or MPI_DATATYPE_NULL)
+    MPI_Datatype* recvtype;           // sorted ghost slots received straight into x (or MPI_DATATYPE_NULL)
+    int nplan;                        // # of requests set up by the last borders
 
     MMD_float* buf_send;                 // send buffer for all comm
     MMD_float* d_buf_send;                 // send buffer for all comm
@@ -73,6 +98,10 @@ typedef struct
 
     int check_safeexchange;           // if sets give warnings if an atom moves further than subdomain size
     int do_safeexchange;		    // exchange atoms with all subdomains within neighbor cutoff
+    MPI_Comm exc_graph[3];            // safe exchange: procs within reach in each dim (dist graph)
+    int exc_degree[3];                // # of those procs (swaps of the dim used by the safe exchange)
+    int* exc_sendcounts, *exc_sdispls;
+    int* exc_recvcounts, *exc_rdispls;
     Timer* timer;
 
     int copy_size;
@@ -93,13 +122,17 @@ void Comm_init(Comm *);
 void Comm_destroy(Comm *);
 int Comm_setup(Comm *, MMD_float, Atom *);
 void Comm_communicate(Comm *, Atom *);
+void Comm_communicate_start(Comm *, Atom *);
+void Comm_communicate_finish(Comm *, Atom *);
 void Comm_reverse_communicate(Comm *, Atom *);
 void Comm_exchange(Comm *, Atom *);
 void Comm_exchange_all(Comm *, Atom *);
 void Comm_borders(Comm *, Atom *);
+void Comm_sort_ghosts(Comm *, Atom *, struct Neighbor_s *);
 void Comm_growsend(Comm *, int);
 void Comm_growrecv(Comm *, int);
 void Comm_growlist(Comm *, int, int);
+int* Comm_recvlist(Comm *, int);
 
 
 #endif
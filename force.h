@@ -37,7 +37,7 @@
 #include "neighbor.h"
 #include "comm.h"
 
-typedef struct
+typedef struct Force_s
 {
     MMD_float cutforce;
     MMD_float cutforcesq;
@@ -48,6 +48,7 @@ typedef struct
 
 
     int use_sse;
+    int simd;                        // SimdIsa of the intrinsics kernels, from Simd_select(use_sse)
     int use_oldcompute;
     ThreadData* threads;
     MMD_int reneigh;
@@ -58,6 +59,11 @@ typedef struct
     ForceStyle style;
 
     MMD_int me;
+
+    int half_threading;              // HalfneighThreading used by the threaded half neighborlist force
+    MMD_float* f_thread;             // per-thread force copies for HALFNEIGH_PRIVATE
+    int f_thread_size;
+    void (*compute_kernel[2])(struct Force_s *, Atom *, Neighbor *, int); // specialized kernel per evflag
 }Force;
 
 //Force *Force_alloc();
@@ -29,7 +29,7 @@
    Please read the accompanying README and LICENSE files.
 ---------------------------------------------------------------------- */
 
-#include "math.h"
+#include "tgmath.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
@@ -39,6 +39,8 @@
 #include "neighbor.h"
 #include "memory.h"
 #include "openacc.h"
+#include "openmp.h"
+#include "simd.h"
 
 #define MAXLINE 1024
 
@@ -60,6 +62,14 @@ ForceEAM *ForceEAM_alloc()
   f->d_fp = f->fp = 0;
   f->style = FORCEEAM;
 
+  f->half_threading = HALFNEIGH_PRIVATE;
+  f->f_thread = NULL;
+  f->f_thread_size = 0;
+  f->simd = SIMD_NONE;
+  f->pair_spline = NULL;
+  f->compute_kernel[0] = f->compute_kernel[1] = NULL;
+  f->comm = NULL;
+
   return f;
 }
 
@@ -72,27 +82,80 @@ void ForceEAM_free(ForceEAM *f)
   free(f);
 }
 
-void ForceEAM_setup(ForceEAM *force_eam, Atom *atom)
+// compute_kernel entries of the kernels, which take the Comm of
+// ForceEAM_compute for the fp exchange; EAM tests evflag at runtime
+
+#define FORCEEAM_ENTRY(name) \
+  static void name##_entry(struct Force_s *force, Atom *atom, Neighbor *neighbor, int me) \
+  { ForceEAM *force_eam = (ForceEAM *) force; name(force_eam, atom, neighbor, force_eam->comm, me); }
+
+#define FORCEEAM_SELECT(name) \
+  do { force_eam->compute_kernel[0] = force_eam->compute_kernel[1] = name##_entry; } while(0)
+
+FORCEEAM_ENTRY(ForceEAM_compute_halfneigh_threaded_atomic)
+FORCEEAM_ENTRY(ForceEAM_compute_halfneigh_threaded)
+FORCEEAM_ENTRY(ForceEAM_compute_halfneigh)
+FORCEEAM_ENTRY(ForceEAM_compute_fullneigh)
+#ifdef HAVE_SIMD_KERNELS
+FORCEEAM_ENTRY(ForceEAM_compute_cluster_avx512)
+FORCEEAM_ENTRY(ForceEAM_compute_cluster_avx2)
+FORCEEAM_ENTRY(ForceEAM_compute_halfneigh_avx512)
+FORCEEAM_ENTRY(ForceEAM_compute_fullneigh_avx512)
+FORCEEAM_ENTRY(ForceEAM_compute_halfneigh_avx2)
+FORCEEAM_ENTRY(ForceEAM_compute_fullneigh_avx2)
+#endif
+
+/* pick the kernel variant once, like ForceLJ_setup */
+
+void ForceEAM_setup(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor)
 {
   force_eam->me = force_eam->threads->mpi_me;
   ForceEAM_coeff(force_eam, "Cu_u6.eam");
   ForceEAM_init_style(force_eam, atom);
+
+  const int threaded = force_eam->threads->omp_num_threads > 1;
+
+  if(neighbor->halfneigh && threaded && force_eam->half_threading == HALFNEIGH_ATOMIC)
+    FORCEEAM_SELECT(ForceEAM_compute_halfneigh_threaded_atomic);
+  else if(neighbor->halfneigh && threaded)
+    FORCEEAM_SELECT(ForceEAM_compute_halfneigh_threaded);
+#ifdef HAVE_SIMD_KERNELS
+  else if(force_eam->simd == SIMD_AVX512 && neighbor->clusterlist)
+    FORCEEAM_SELECT(ForceEAM_compute_cluster_avx512);
+  else if(force_eam->simd == SIMD_AVX2 && neighbor->clusterlist)
+    FORCEEAM_SELECT(ForceEAM_compute_cluster_avx2);
+  else if(force_eam->simd == SIMD_AVX512 && neighbor->halfneigh)
+    FORCEEAM_SELECT(ForceEAM_compute_halfneigh_avx512);
+  else if(force_eam->simd == SIMD_AVX512)
+    FORCEEAM_SELECT(ForceEAM_compute_fullneigh_avx512);
+  else if(force_eam->simd == SIMD_AVX2 && neighbor->halfneigh)
+    FORCEEAM_SELECT(ForceEAM_compute_halfneigh_avx2);
+  else if(force_eam->simd == SIMD_AVX2)
+    FORCEEAM_SELECT(ForceEAM_compute_fullneigh_avx2);
+#endif
+  else if(neighbor->halfneigh)
+    FORCEEAM_SELECT(ForceEAM_compute_halfneigh);
+  else
+    FORCEEAM_SELECT(ForceEAM_compute_fullneigh);
 }
 
 
 void ForceEAM_compute(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor, Comm *comm, int me)
 {
-  if(neighbor->halfneigh) {
-    if(force_eam->threads->omp_num_threads > 1) {
-      return ;
-    } else {
-      ForceEAM_compute_halfneigh(force_eam, atom, neighbor, comm, me);
-      return;
-    }
-  } else {
-    ForceEAM_compute_fullneigh(force_eam, atom, neighbor, comm, me);
-    return;
-  }
+  // the half neighborlist and intrinsics variants are host kernels (MPI + OpenMP):
+  // fetch positions from the device before and push forces back afterwards
+
+  const int host_kernel = neighbor->halfneigh || force_eam->simd != SIMD_NONE;
+  const int nall = atom->nlocal + atom->nghost;
+
+  if(host_kernel)
+    Atom_sync_host(atom, &atom->x[0][0], atom->d_x, nall * PAD * sizeof(MMD_float));
+
+  force_eam->comm = comm;
+  force_eam->compute_kernel[force_eam->evflag ? 1 : 0]((struct Force_s *) force_eam, atom, neighbor, me);
+
+  if(host_kernel)
+    Atom_sync_device(atom, atom->d_f, &atom->f[0][0], nall * PAD * sizeof(MMD_float));
 }
 /* ---------------------------------------------------------------------- */
 
@@ -117,6 +180,7 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
   MMD_float* x = &atom->x[0][0];
   MMD_float* f = &atom->f[0][0];
   const int nlocal = atom->nlocal;
+  const MMD_pfloat rdr = force_eam->rdr;
 
   // zero out density
 
@@ -132,7 +196,7 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
   // loop over neighbors of my atoms
 
   for(MMD_int i = 0; i < nlocal; i++) {
-    int* neighs = &neighbor->neighbors[i * neighbor->maxneighs];
+    int* neighs = &neighbor->neighbors[FIRSTNEIGH(neighbor->firstneigh, i)];
     const int numneigh = neighbor->numneigh[i];
     const MMD_float xtmp = x[i * PAD + 0];
     const MMD_float ytmp = x[i * PAD + 1];
@@ -140,19 +204,19 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
     MMD_float rhoi = 0.0;
 
     for(MMD_int jj = 0; jj < numneigh; jj++) {
-      const MMD_int j = neighs[jj];
+      const MMD_int j = neighs[jj * DS1(neighbor->nmax,neighbor->maxneighs)];
 
-      const MMD_float delx = xtmp - x[j * PAD + 0];
-      const MMD_float dely = ytmp - x[j * PAD + 1];
-      const MMD_float delz = ztmp - x[j * PAD + 2];
-      const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
 
       if(rsq < force_eam->cutforcesq) {
-        MMD_float p = sqrt(rsq) * force_eam->rdr + 1.0;
+        MMD_pfloat p = sqrt(rsq) * rdr + 1.0f;
         MMD_int m = (int)(p);
         m = m < force_eam->nr - 1 ? m : force_eam->nr - 1;
         p -= m;
-        p = p < 1.0 ? p : 1.0;
+        p = p < 1.0f ? p : 1.0f;
 
         rhoi += ((force_eam->rhor_spline[m * 7 + 3] * p + force_eam->rhor_spline[m * 7 + 4]) * p + force_eam->rhor_spline[m * 7 + 5]) * p + force_eam->rhor_spline[m * 7 + 6];
 
@@ -190,7 +254,7 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
   // compute forces on each atom
   // loop over neighbors of my atoms
   for(MMD_int i = 0; i < nlocal; i++) {
-    int* neighs = &neighbor->neighbors[i * neighbor->maxneighs];
+    int* neighs = &neighbor->neighbors[FIRSTNEIGH(neighbor->firstneigh, i)];
     const int numneigh = neighbor->numneigh[i];
     const MMD_float xtmp = x[i * PAD + 0];
     const MMD_float ytmp = x[i * PAD + 1];
@@ -202,21 +266,21 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
     //printf("Hallo %i %i %lf %lf\n",i,numneigh[i],sqrt(cutforcesq),neighbor.cutneigh);
 
     for(MMD_int jj = 0; jj < numneigh; jj++) {
-      const MMD_int j = neighs[jj];
+      const MMD_int j = neighs[jj * DS1(neighbor->nmax,neighbor->maxneighs)];
 
-      const MMD_float delx = xtmp - x[j * PAD + 0];
-      const MMD_float dely = ytmp - x[j * PAD + 1];
-      const MMD_float delz = ztmp - x[j * PAD + 2];
-      const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
 
       //printf("EAM: %i %i %lf %lf\n",i,j,rsq,cutforcesq);
       if(rsq < force_eam->cutforcesq) {
-        MMD_float r = sqrt(rsq);
-        MMD_float p = r * force_eam->rdr + 1.0;
+        MMD_pfloat r = sqrt(rsq);
+        MMD_pfloat p = r * rdr + 1.0f;
         MMD_int m = (int)(p);
         m = m < force_eam->nr - 1 ? m : force_eam->nr - 1;
         p -= m;
-        p = p < 1.0 ? p : 1.0;
+        p = p < 1.0f ? p : 1.0f;
 
 
         // rhoip = derivative of (density at atom j due to atom i)
@@ -229,15 +293,15 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
         //   terms of embed eng: Fi(sum rho_ij) and Fj(sum rho_ji)
         //   hence embed' = Fi(sum rho_ij) rhojp + Fj(sum rho_ji) rhoip
 
-        MMD_float rhoip = (force_eam->rhor_spline[m * 7 + 0] * p + force_eam->rhor_spline[m * 7 + 1]) * p + force_eam->rhor_spline[m * 7 + 2];
-        MMD_float z2p = (force_eam->z2r_spline[m * 7 + 0] * p + force_eam->z2r_spline[m * 7 + 1]) * p + force_eam->z2r_spline[m * 7 + 2];
-        MMD_float z2 = ((force_eam->z2r_spline[m * 7 + 3] * p + force_eam->z2r_spline[m * 7 + 4]) * p + force_eam->z2r_spline[m * 7 + 5]) * p + force_eam->z2r_spline[m * 7 + 6];
+        MMD_pfloat rhoip = (force_eam->rhor_spline[m * 7 + 0] * p + force_eam->rhor_spline[m * 7 + 1]) * p + force_eam->rhor_spline[m * 7 + 2];
+        MMD_pfloat z2p = (force_eam->z2r_spline[m * 7 + 0] * p + force_eam->z2r_spline[m * 7 + 1]) * p + force_eam->z2r_spline[m * 7 + 2];
+        MMD_pfloat z2 = ((force_eam->z2r_spline[m * 7 + 3] * p + force_eam->z2r_spline[m * 7 + 4]) * p + force_eam->z2r_spline[m * 7 + 5]) * p + force_eam->z2r_spline[m * 7 + 6];
 
-        MMD_float recip = 1.0 / r;
-        MMD_float phi = z2 * recip;
-        MMD_float phip = z2p * recip - phi * recip;
-        MMD_float psip = force_eam->fp[i] * rhoip + force_eam->fp[j] * rhoip + phip;
-        MMD_float fpair = -psip * recip;
+        MMD_pfloat recip = 1.0f / r;
+        MMD_pfloat phi = z2 * recip;
+        MMD_pfloat phip = z2p * recip - phi * recip;
+        MMD_pfloat psip = (MMD_pfloat) force_eam->fp[i] * rhoip + (MMD_pfloat) force_eam->fp[j] * rhoip + phip;
+        MMD_pfloat fpair = -psip * recip;
 
         fx += delx * fpair;
         fy += dely * fpair;
@@ -249,7 +313,7 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
           f[j * PAD + 0] -= delx * fpair;
           f[j * PAD + 1] -= dely * fpair;
           f[j * PAD + 2] -= delz * fpair;
-        } else fpair *= 0.5;
+        } else fpair *= 0.5f;
 
         if(force_eam->evflag) {
           force_eam->virial += delx * delx * fpair + dely * dely * fpair + delz * delz * fpair;
@@ -270,11 +334,33 @@ void ForceEAM_compute_halfneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
 
 /* ---------------------------------------------------------------------- */
 
+void ForceEAM_grow_fthread(ForceEAM *force_eam, int n)
+{
+  if(n <= force_eam->f_thread_size) return;
+
+  if(force_eam->f_thread) free(force_eam->f_thread);
+
+  force_eam->f_thread_size = n;
+  force_eam->f_thread = (MMD_float*) malloc(n * sizeof(MMD_float));
+}
+
+// the threaded half neighborlist kernel once per threading mode
+
+#define HALF_ATOMIC 0
+#include "force_eam_threaded.h"
+#undef HALF_ATOMIC
+#define HALF_ATOMIC 1
+#include "force_eam_threaded.h"
+#undef HALF_ATOMIC
+
+/* ---------------------------------------------------------------------- */
+
 void ForceEAM_compute_fullneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor, Comm *comm, int me)
 {
 
   MMD_float evdwl = 0.0;
 
+  force_eam->eng_vdwl = 0;
   force_eam->virial = 0;
   // grow energy and fp arrays if necessary
   // need to be atom->nmax in length
@@ -301,29 +387,31 @@ void ForceEAM_compute_fullneigh(ForceEAM *force_eam, Atom *atom, Neighbor *neigh
   MMD_float* const restrict f = atom->d_f;
   const int* const restrict neighbors = neighbor->d_neighbors;
   const int* const restrict numneighs = neighbor->d_numneigh;
-  const int maxneighs = neighbor->maxneighs;
+  const int* const restrict firstneigh = neighbor->d_firstneigh;
+  const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
   const int nrho_ = force_eam->nrho;
   const int nr_ = force_eam->nr;
   const MMD_float cutforcesq_ = force_eam->cutforcesq;
-  const int nmax = neighbor->nmax;
-  const MMD_float rdr_ = force_eam->rdr;
+  const MMD_pfloat rdr_ = force_eam->rdr;
   const MMD_float rdrho_ = force_eam->rdrho;
+  const int evflag = force_eam->evflag;
 
   MMD_float* const restrict fp_ = force_eam->fp;
-  const MMD_float* const restrict rhor_spline_= force_eam->d_rhor_spline;
-  const MMD_float* const restrict frho_spline_= force_eam->d_frho_spline;
-  const MMD_float* const restrict z2r_spline_= force_eam->d_z2r_spline;
+  const MMD_pfloat* const restrict rhor_spline_= force_eam->d_rhor_spline;
+  const MMD_pfloat* const restrict frho_spline_= force_eam->d_frho_spline;
+  const MMD_pfloat* const restrict z2r_spline_= force_eam->d_z2r_spline;
 
 // zero out density
 
   // rho = density at each atom
   // loop over neighbors of my atoms
-printf("Kernel1\n");
-#pragma acc data copyout(fp_[0:nall]) deviceptr(rhor_spline_,frho_spline_,x,neighbors,numneighs)
+#pragma acc data copyout(fp_[0:nall]) deviceptr(rhor_spline_,frho_spline_,x,neighbors,numneighs,firstneigh)
 {
-  #pragma acc kernels
+  // the embedding energy is reduced on the device in the same kernel
+
+  #pragma acc parallel loop reduction(+:evdwl)
   for(MMD_int i = 0; i < nlocal; i++) {
-    const int* const restrict neighs = &neighbors[i * DS0(nmax,maxneighs)];
+    const int* const restrict neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
     const int jnum = numneighs[i];
     const MMD_float xtmp = x[i * PAD + 0];
     const MMD_float ytmp = x[i * PAD + 1];
@@ -332,19 +420,19 @@ printf("Kernel1\n");
 
     #pragma ivdep
     for(MMD_int jj = 0; jj < jnum; jj++) {
-      const MMD_int j = neighs[jj*DS1(nmax,maxneighs)];
+      const MMD_int j = neighs[jj*stride];
 
-      const MMD_float delx = xtmp - x[j * PAD + 0];
-      const MMD_float dely = ytmp - x[j * PAD + 1];
-      const MMD_float delz = ztmp - x[j * PAD + 2];
-      const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
 
       if(rsq < cutforcesq_) {
-        MMD_float p = sqrt(rsq) * rdr_ + 1.0;
+        MMD_pfloat p = sqrt(rsq) * rdr_ + 1.0f;
         MMD_int m = (int)(p);
         m = m < nr_ - 1 ? m : nr_ - 1;
         p -= m;
-        p = p < 1.0 ? p : 1.0;
+        p = p < 1.0f ? p : 1.0f;
 
         rhoi += ((rhor_spline_[m * 7 + 3] * p + rhor_spline_[m * 7 + 4]) * p + rhor_spline_[m * 7 + 5]) * p + rhor_spline_[m * 7 + 6];
       }
@@ -358,11 +446,9 @@ printf("Kernel1\n");
     fp_[i] = (frho_spline_[m * 7 + 0] * p + frho_spline_[m * 7 + 1]) * p + frho_spline_[m * 7 + 2];
 
     // printf("fp: %lf %lf %lf %lf %lf %i %lf %lf\n",fp[i],p,frho_spline[m*7+0],frho_spline[m*7+1],frho_spline[m*7+2],m,rdrho,rho[i]);
-    #ifdef ENABLE_EV_CALCULATION
     if(evflag) {
-      evdwl += ((frho_spline[m * 7 + 3] * p + frho_spline[m * 7 + 4]) * p + frho_spline[m * 7 + 5]) * p + frho_spline[m * 7 + 6];
+      evdwl += ((frho_spline_[m * 7 + 3] * p + frho_spline_[m * 7 + 4]) * p + frho_spline_[m * 7 + 5]) * p + frho_spline_[m * 7 + 6];
     }
-    #endif
 
   }
 }
@@ -383,13 +469,12 @@ printf("Kernel1\n");
   // compute forces on each atom
   // loop over neighbors of my atoms
 
-printf("Kernel2\n");
   
-#pragma acc data copyin(fp_[0:nall]) deviceptr(f,x,neighbors,numneighs,rhor_spline_,z2r_spline_)
+#pragma acc data copyin(fp_[0:nall]) deviceptr(f,x,neighbors,numneighs,firstneigh,rhor_spline_,z2r_spline_)
 {
-  #pragma acc kernels
+  #pragma acc parallel loop reduction(+:evdwl,t_virial)
   for(MMD_int i = 0; i < nlocal; i++) {
-    const int* const restrict neighs = &neighbors[i * DS0(nmax,maxneighs)];
+    const int* const restrict neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
     const int numneigh = numneighs[i];
     const MMD_float xtmp = x[i * PAD + 0];
     const MMD_float ytmp = x[i * PAD + 1];
@@ -401,21 +486,21 @@ printf("Kernel2\n");
 
     #pragma ivdep
     for(MMD_int jj = 0; jj < numneigh; jj++) {
-      const MMD_int j = neighs[jj*DS1(nmax,maxneighs)];
+      const MMD_int j = neighs[jj*stride];
 
-      const MMD_float delx = xtmp - x[j * PAD + 0];
-      const MMD_float dely = ytmp - x[j * PAD + 1];
-      const MMD_float delz = ztmp - x[j * PAD + 2];
-      const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
       //printf("EAM: %i %i %lf %lf // %lf %lf\n",i,j,rsq,cutforcesq,fp[i],fp[j]);
 
       if(rsq < cutforcesq_) {
-        MMD_float r = sqrt(rsq);
-        MMD_float p = r * rdr_ + 1.0;
+        MMD_pfloat r = sqrt(rsq);
+        MMD_pfloat p = r * rdr_ + 1.0f;
         MMD_int m = (int)(p);
         m = m < nr_ - 1 ? m : nr_ - 1;
         p -= m;
-        p = p < 1.0 ? p : 1.0;
+        p = p < 1.0f ? p : 1.0f;
 
 
         // rhoip = derivative of (density at atom j due to atom i)
@@ -428,29 +513,27 @@ printf("Kernel2\n");
         //   terms of embed eng: Fi(sum rho_ij) and Fj(sum rho_ji)
         //   hence embed' = Fi(sum rho_ij) rhojp + Fj(sum rho_ji) rhoip
 
-        MMD_float rhoip = (rhor_spline_[m * 7 + 0] * p + rhor_spline_[m * 7 + 1]) * p + rhor_spline_[m * 7 + 2];
-        MMD_float z2p = (z2r_spline_[m * 7 + 0] * p + z2r_spline_[m * 7 + 1]) * p + z2r_spline_[m * 7 + 2];
-        MMD_float z2 = ((z2r_spline_[m * 7 + 3] * p + z2r_spline_[m * 7 + 4]) * p + z2r_spline_[m * 7 + 5]) * p + z2r_spline_[m * 7 + 6];
+        MMD_pfloat rhoip = (rhor_spline_[m * 7 + 0] * p + rhor_spline_[m * 7 + 1]) * p + rhor_spline_[m * 7 + 2];
+        MMD_pfloat z2p = (z2r_spline_[m * 7 + 0] * p + z2r_spline_[m * 7 + 1]) * p + z2r_spline_[m * 7 + 2];
+        MMD_pfloat z2 = ((z2r_spline_[m * 7 + 3] * p + z2r_spline_[m * 7 + 4]) * p + z2r_spline_[m * 7 + 5]) * p + z2r_spline_[m * 7 + 6];
 
-        MMD_float recip = 1.0 / r;
-        MMD_float phi = z2 * recip;
-        MMD_float phip = z2p * recip - phi * recip;
-        MMD_float psip = fp_[i] * rhoip + fp_[j] * rhoip + phip;
-        MMD_float fpair = -psip * recip;
+        MMD_pfloat recip = 1.0f / r;
+        MMD_pfloat phi = z2 * recip;
+        MMD_pfloat phip = z2p * recip - phi * recip;
+        MMD_pfloat psip = (MMD_pfloat) fp_[i] * rhoip + (MMD_pfloat) fp_[j] * rhoip + phip;
+        MMD_pfloat fpair = -psip * recip;
 
         fx += delx * fpair;
         fy += dely * fpair;
         fz += delz * fpair;
         //  	if(i==0&&j<20)
         //      printf("fpair: %i %i %lf %lf %lf %lf\n",i,j,fpair,delx,dely,delz);
-        fpair *= 0.5;
+        fpair *= 0.5f;
 
-#ifdef ENABLE_EV_CALCULATION
         if(evflag) {
           t_virial += delx * delx * fpair + dely * dely * fpair + delz * delz * fpair;
           evdwl += 0.5 * phi;
         }
-#endif
 
       }
     }
@@ -461,7 +544,6 @@ printf("Kernel2\n");
 
   }
 }
-printf("ForceEAM done\n");  
   force_eam->virial += t_virial;
   
   force_eam->eng_vdwl += 2.0 * evdwl;
@@ -754,13 +836,13 @@ void ForceEAM_array2spline(ForceEAM *force_eam, Atom *atom)
   force_eam->rdr = 1.0 / force_eam->dr;
   force_eam->rdrho = 1.0 / force_eam->drho;
 
-  force_eam->frho_spline = (MMD_float *) malloc(sizeof(MMD_float) * ((force_eam->nrho + 1) * 7));
-  force_eam->rhor_spline = (MMD_float *) malloc(sizeof(MMD_float) * ((force_eam->nr + 1) * 7));
-  force_eam->z2r_spline = (MMD_float *) malloc(sizeof(MMD_float) * ((force_eam->nr + 1) * 7));
+  force_eam->frho_spline = (MMD_pfloat *) malloc(sizeof(MMD_pfloat) * ((force_eam->nrho + 1) * 7));
+  force_eam->rhor_spline = (MMD_pfloat *) malloc(sizeof(MMD_pfloat) * ((force_eam->nr + 1) * 7));
+  force_eam->z2r_spline = (MMD_pfloat *) malloc(sizeof(MMD_pfloat) * ((force_eam->nr + 1) * 7));
 
-  force_eam->d_frho_spline = (MMD_float*) acc_malloc((force_eam->nrho + 1) * 7 * sizeof(MMD_float));
-  force_eam->d_rhor_spline = (MMD_float*) acc_malloc((force_eam->nr + 1) * 7 * sizeof(MMD_float));
-  force_eam->d_z2r_spline  = (MMD_float*) acc_malloc((force_eam->nr + 1) * 7 * sizeof(MMD_float));
+  force_eam->d_frho_spline = (MMD_pfloat*) acc_malloc((force_eam->nrho + 1) * 7 * sizeof(MMD_pfloat));
+  force_eam->d_rhor_spline = (MMD_pfloat*) acc_malloc((force_eam->nr + 1) * 7 * sizeof(MMD_pfloat));
+  force_eam->d_z2r_spline  = (MMD_pfloat*) acc_malloc((force_eam->nr + 1) * 7 * sizeof(MMD_pfloat));
 
   ForceEAM_interpolate(force_eam, force_eam->nrho, force_eam->drho, force_eam->frho, force_eam->frho_spline);
 
@@ -772,14 +854,29 @@ void ForceEAM_array2spline(ForceEAM *force_eam, Atom *atom)
 
   //printf("RhorSpline: %e %e %e %e\n",rhor_spline(119,3),rhor_spline(119,4),rhor_spline(119,5),rhor_spline(119,6));
   //printf("FrhoSpline: %e %e %e %e\n",frho_spline(119,3),frho_spline(119,4),frho_spline(119,5),frho_spline(119,6));
-  Atom_sync_device(atom, force_eam->d_frho_spline,force_eam->frho_spline,(force_eam->nrho + 1) * 7 *sizeof(MMD_float));
-  Atom_sync_device(atom, force_eam->d_rhor_spline,force_eam->rhor_spline,(force_eam->nr + 1) * 7 *sizeof(MMD_float));
-  Atom_sync_device(atom, force_eam->d_z2r_spline,force_eam->z2r_spline,(force_eam->nr + 1) * 7 *sizeof(MMD_float));
+  Atom_sync_device(atom, force_eam->d_frho_spline,force_eam->frho_spline,(force_eam->nrho + 1) * 7 *sizeof(MMD_pfloat));
+  Atom_sync_device(atom, force_eam->d_rhor_spline,force_eam->rhor_spline,(force_eam->nr + 1) * 7 *sizeof(MMD_pfloat));
+  Atom_sync_device(atom, force_eam->d_z2r_spline,force_eam->z2r_spline,(force_eam->nr + 1) * 7 *sizeof(MMD_pfloat));
+
+  // gather friendly copy of the pair splines for the intrinsics kernels
+
+  if(force_eam->simd != SIMD_NONE) {
+    const int size = (force_eam->nr + 1) * EAM_SIMD_STRIDE * sizeof(MMD_float);
+
+    free(force_eam->pair_spline);
+    force_eam->pair_spline = (MMD_float*) aligned_alloc(64, (size + 63) / 64 * 64);
+
+    for(int m = 0; m <= force_eam->nr; m++)
+      for(int k = 0; k < EAM_SIMD_STRIDE / 2; k++) {
+        force_eam->pair_spline[m * EAM_SIMD_STRIDE + k] = k < 7 ? force_eam->rhor_spline[m * 7 + k] : 0.0;
+        force_eam->pair_spline[m * EAM_SIMD_STRIDE + EAM_SIMD_STRIDE / 2 + k] = k < 7 ? force_eam->z2r_spline[m * 7 + k] : 0.0;
+      }
+  }
 }
 
 /* ---------------------------------------------------------------------- */
 
-void ForceEAM_interpolate(ForceEAM *force_eam, MMD_int n, MMD_float delta, MMD_float* f, MMD_float* spline)
+void ForceEAM_interpolate(ForceEAM *force_eam, MMD_int n, MMD_float delta, MMD_float* f, MMD_pfloat* spline)
 {
   for(int m = 1; m <= n; m++) spline[m * 7 + 6] = f[m];
 
@@ -839,7 +936,7 @@ MMD_float ForceEAM_single(ForceEAM *force_eam, int i, int j, int itype, int jtyp
 {
   int m;
   MMD_float r, p, rhoip, rhojp, z2, z2p, recip, phi, phip, psip;
-  MMD_float* coeff;
+  MMD_pfloat* coeff;
 
   r = sqrt(rsq);
   p = r * force_eam->rdr + 1.0;
@@ -867,50 +964,45 @@ MMD_float ForceEAM_single(ForceEAM *force_eam, int i, int j, int itype, int jtyp
 
 void ForceEAM_communicate(ForceEAM *force_eam, Atom *atom, Comm *comm)
 {
-
   int iswap;
-  int pbc_flags[4];
   MMD_float* buf;
-  MPI_Request request;
-  MPI_Status status;
+
+  /* swaps whose send list holds only local atoms go out first (all of them
+     with the direct halo), the others follow in order once the ghosts they
+     forward have arrived */
+
+  for(iswap = 0; iswap < comm->nswap; iswap++)
+    if(comm->sendlocal[iswap]) {
+      ForceEAM_pack_comm(force_eam, comm->sendnum[iswap], iswap, &comm->buf_send[comm->buf_offset[iswap]], comm->sendlist);
+
+      if(comm->sendproc[iswap] != force_eam->me)
+        MPI_Startall(2, &comm->requests[PLAN_N * iswap + PLAN_FP]);
+    }
 
   for(iswap = 0; iswap < comm->nswap; iswap++) {
 
     /* pack buffer */
 
-    pbc_flags[0] = comm->pbc_any[iswap];
-    pbc_flags[1] = comm->pbc_flagx[iswap];
-    pbc_flags[2] = comm->pbc_flagy[iswap];
-    pbc_flags[3] = comm->pbc_flagz[iswap];
-    //timer->stamp_extra_start();
+    buf = &comm->buf_send[comm->buf_offset[iswap]];
 
-    int size = ForceEAM_pack_comm(force_eam, comm->sendnum[iswap], iswap, comm->buf_send, comm->sendlist);
-    //timer->stamp_extra_stop(TIME_TEST);
+    if(!comm->sendlocal[iswap])
+      ForceEAM_pack_comm(force_eam, comm->sendnum[iswap], iswap, buf, comm->sendlist);
 
-
-    /* exchange with another proc
+    /* exchange with another proc (requests of the plan from Comm_borders)
        if self, set recv buffer to send buffer */
 
     if(comm->sendproc[iswap] != force_eam->me) {
-      if(sizeof(MMD_float) == 4) {
-        MPI_Irecv(comm->buf_recv, comm->comm_recv_size[iswap], MPI_FLOAT,
-                  comm->recvproc[iswap], 0, MPI_COMM_WORLD, &request);
-        MPI_Send(comm->buf_send, comm->comm_send_size[iswap], MPI_FLOAT,
-                 comm->sendproc[iswap], 0, MPI_COMM_WORLD);
-      } else {
-        MPI_Irecv(comm->buf_recv, comm->comm_recv_size[iswap], MPI_DOUBLE,
-                  comm->recvproc[iswap], 0, MPI_COMM_WORLD, &request);
-        MPI_Send(comm->buf_send, comm->comm_send_size[iswap], MPI_DOUBLE,
-                 comm->sendproc[iswap], 0, MPI_COMM_WORLD);
-      }
+      MPI_Request* const request = &comm->requests[PLAN_N * iswap + PLAN_FP];
 
-      MPI_Wait(&request, &status);
-      buf = comm->buf_recv;
-    } else buf = comm->buf_send;
+      if(!comm->sendlocal[iswap]) MPI_Startall(2, request);
+
+      MPI_Waitall(2, request, MPI_STATUSES_IGNORE);
+      buf = &comm->buf_recv[comm->buf_offset[iswap]];
+    }
 
     /* unpack buffer */
 
-    ForceEAM_unpack_comm(force_eam, comm->recvnum[iswap], comm->firstrecv[iswap], buf);
+    ForceEAM_unpack_comm(force_eam, comm->recvnum[iswap], comm->firstrecv[iswap], Comm_recvlist(comm, iswap), buf);
   }
 }
 /* ---------------------------------------------------------------------- */
@@ -931,10 +1023,16 @@ int ForceEAM_pack_comm(ForceEAM *force_eam, int n, int iswap, MMD_float* buf, in
 
 /* ---------------------------------------------------------------------- */
 
-void ForceEAM_unpack_comm(ForceEAM *force_eam, int n, int first, MMD_float* buf)
+void ForceEAM_unpack_comm(ForceEAM *force_eam, int n, int first, int* list, MMD_float* buf)
 {
   int i, m, last;
 
+  if(list) {
+    for(i = 0; i < n; i++) force_eam->fp[list[i]] = buf[i];
+
+    return;
+  }
+
   m = 0;
   last = first + n;
 
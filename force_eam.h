@@ -42,6 +42,8 @@
 #include "comm.h"
 #include "force.h"
 
+#define EAM_SIMD_STRIDE 16
+
 struct Funcfl {
   char* file;
   MMD_int nrho, nr;
@@ -66,6 +68,7 @@ typedef struct
 
 
         int use_sse;
+        int simd;                        // SimdIsa of the intrinsics kernels, from Simd_select(use_sse)
         int use_oldcompute;
         ThreadData* threads;
         MMD_int reneigh;
@@ -76,6 +79,11 @@ typedef struct
         ForceStyle style;
 
         MMD_int me;
+
+        int half_threading;              // HalfneighThreading used by the threaded half neighborlist force
+        MMD_float* f_thread;             // per-thread force copies for HALFNEIGH_PRIVATE
+        int f_thread_size;
+        void (*compute_kernel[2])(struct Force_s *, Atom *, Neighbor *, int); // specialized kernel per evflag
     // end copy-paste of Force struct
 
 
@@ -92,8 +100,13 @@ typedef struct
     // potentials in spline form used for force computation
 
     MMD_float dr, rdr, drho, rdrho;
-    MMD_float* rhor_spline, *frho_spline, *z2r_spline;
-    MMD_float* d_rhor_spline, *d_frho_spline, *d_z2r_spline;
+    MMD_pfloat* rhor_spline, *frho_spline, *z2r_spline;
+    MMD_pfloat* d_rhor_spline, *d_frho_spline, *d_z2r_spline;
+
+    // rhor (0-6) and z2r (8-14) coefficients of each knot in one 64 byte
+    // aligned row, so the intrinsics kernels gather them from 1-2 cache lines
+
+    MMD_float* pair_spline;
 
 
     // per-atom arrays
@@ -102,6 +115,8 @@ typedef struct
 
     MMD_int nmax;
 
+    Comm* comm;                     // of the current ForceEAM_compute, for the compute_kernel entries
+
     // potentials as file data
 
     MMD_int* map;                   // which element each atom type maps to
@@ -116,21 +131,24 @@ void ForceEAM_free(ForceEAM *);
 
 void ForceEAM_compute(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
 void ForceEAM_coeff(ForceEAM *, char*);
-void ForceEAM_setup(ForceEAM *, Atom *atom);
+void ForceEAM_setup(ForceEAM *, Atom *atom, Neighbor *neighbor);
 void ForceEAM_init_style(ForceEAM *, Atom * atom);
 MMD_float ForceEAM_single(ForceEAM *, MMD_int, MMD_int, MMD_int, MMD_int, MMD_float, MMD_float, MMD_float, MMD_float *);
 
 MMD_int ForceEAM_pack_comm(ForceEAM *, int n, int iswap, MMD_float* buf, MMD_int** asendlist);
-void ForceEAM_unpack_comm(ForceEAM *, int n, int first, MMD_float* buf);
+void ForceEAM_unpack_comm(ForceEAM *, int n, int first, int* list, MMD_float* buf);
 MMD_int ForceEAM_pack_reverse_comm(ForceEAM *, MMD_int, MMD_int, MMD_float*);
 void ForceEAM_unpack_reverse_comm(ForceEAM *, MMD_int, MMD_int*, MMD_float*);
 MMD_float ForceEAM_memory_usage(ForceEAM *);
 
 void ForceEAM_compute_halfneigh(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_halfneigh_threaded(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_halfneigh_threaded_atomic(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
 void ForceEAM_compute_fullneigh(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_grow_fthread(ForceEAM *, int n);
 
 void ForceEAM_array2spline(ForceEAM *, Atom * atom);
-void ForceEAM_interpolate(ForceEAM *, MMD_int n, MMD_float delta, MMD_float* f, MMD_float* spline);
+void ForceEAM_interpolate(ForceEAM *, MMD_int n, MMD_float delta, MMD_float* f, MMD_pfloat* spline);
 void ForceEAM_grab(ForceEAM *, FILE*, MMD_int, MMD_float*);
 
 void ForceEAM_read_file(ForceEAM *, char*);
@@ -140,5 +158,13 @@ void ForceEAM_bounds(ForceEAM *, char* str, int nmax, int *nlo, int *nhi);
 
 void ForceEAM_communicate(ForceEAM *, Atom *atom, Comm *comm);
 
+// intrinsics kernels from force_eam_simd.c (force_eam_simd.h per ISA)
+void ForceEAM_compute_fullneigh_avx2(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_halfneigh_avx2(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_fullneigh_avx512(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_halfneigh_avx512(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_cluster_avx2(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+void ForceEAM_compute_cluster_avx512(ForceEAM *, Atom *atom, Neighbor *neighbor, Comm *comm, int me);
+
 #endif
 
@@ -0,0 +1,554 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+/* intrinsics EAM kernels, included by force_eam_simd.c once per ISA after
+   simd_isa.h has set up the vector macros for SIMD_ISA
+   -host kernels on atom->x / atom->f with layout right neighborlists
+   -sqrt, the spline index m and the fraction p are computed in vectors,
+    the knot coefficients are gathered from force_eam->pair_spline, where
+    the rhor and z2r coefficients of one knot share a 64 byte aligned row
+    of EAM_SIMD_STRIDE entries (one or two cache lines per lane)
+   -the lists are padded with i up to CHUNKSIZE, the padding lanes have
+    rsq == 0 and drop out of the cutoff mask
+   -the embedding function is evaluated once per atom and stays scalar */
+
+#define FORCEEAM_SIMD_PASTE(name, isa) name##_##isa
+#define FORCEEAM_SIMD_NAME(name, isa) FORCEEAM_SIMD_PASTE(name, isa)
+#define FORCEEAM_SIMD_KERNEL(name) FORCEEAM_SIMD_NAME(name, SIMD_ISA)
+
+// spline knot index m and fraction p of the pair distance r, clamped as in the scalar kernels
+#define FORCEEAM_SIMD_KNOT(r, idx, p) \
+  { \
+    const vreal pr = V_FMA(r, rdr, one); \
+    const vindex m = I_MIN(I_CVTV(pr), I_SET1(force_eam->nr - 1)); \
+    p = V_MIN(V_SUB(pr, V_CVTI(m)), one); \
+    idx = I_MULC(m, EAM_SIMD_STRIDE); \
+  }
+
+// embedding function of atom i (scalar), returns F(rho) and stores F'(rho) in fp[i]
+static inline MMD_float FORCEEAM_SIMD_KERNEL(ForceEAM_embed)(ForceEAM *force_eam, MMD_float rho, MMD_float* fp, int i)
+{
+  const MMD_pfloat* const frho_spline = force_eam->frho_spline;
+  MMD_float p = 1.0 * rho * force_eam->rdrho + 1.0;
+  MMD_int m = (int)(p);
+  m = MAX(1, MIN(m, force_eam->nrho - 1));
+  p -= m;
+  p = MIN(p, 1.0);
+  fp[i] = (frho_spline[m * 7 + 0] * p + frho_spline[m * 7 + 1]) * p + frho_spline[m * 7 + 2];
+
+  return ((frho_spline[m * 7 + 3] * p + frho_spline[m * 7 + 4]) * p + frho_spline[m * 7 + 5]) * p + frho_spline[m * 7 + 6];
+}
+
+//full neighborlists
+//  -MPI + OpenMP, no write conflicts
+SIMD_TARGET
+void FORCEEAM_SIMD_KERNEL(ForceEAM_compute_fullneigh)(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor, Comm *comm, int me)
+{
+  if(atom->nmax > force_eam->nmax) {
+    force_eam->nmax = atom->nmax;
+    free(force_eam->fp);
+    force_eam->fp = (MMD_float *) malloc(sizeof(MMD_float) * force_eam->nmax);
+  }
+
+  const int nlocal = atom->nlocal;
+  const int* const restrict firstneigh = neighbor->firstneigh;
+  const int nthreads = force_eam->threads->omp_num_threads;
+  const int evflag = force_eam->evflag;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  const int* const restrict neighbors = neighbor->neighbors;
+  const int* const restrict numneigh = neighbor->numneigh;
+  const MMD_float* const restrict spline = force_eam->pair_spline;
+  MMD_float* const restrict fp = force_eam->fp;
+
+  MMD_float evdwl = 0;
+  MMD_float t_virial = 0;
+
+  // rho = density at each atom, fp = derivative of embedding energy
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:evdwl)
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[firstneigh[i]];
+    const int numneighs = (numneigh[i] + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    const vreal xtmp = V_SET1(x[i * PAD + 0]);
+    const vreal ytmp = V_SET1(x[i * PAD + 1]);
+    const vreal ztmp = V_SET1(x[i * PAD + 2]);
+    const vreal cutforcesq = V_SET1(force_eam->cutforcesq);
+    const vreal rdr = V_SET1(force_eam->rdr);
+    const vreal one = V_SET1(1.0);
+    vreal rhoi = V_ZERO();
+
+    for(int k = 0; k < numneighs; k += SIMD_WIDTH) {
+      const vindex j = I_MULC(I_LOAD(&neighs[k]), PAD);
+      const vreal delx = V_SUB(xtmp, V_GATHER(x + 0, j));
+      const vreal dely = V_SUB(ytmp, V_GATHER(x + 1, j));
+      const vreal delz = V_SUB(ztmp, V_GATHER(x + 2, j));
+      const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+      const vmask mask = M_CUTOFF(rsq, cutforcesq);
+      vindex idx;
+      vreal p;
+
+      FORCEEAM_SIMD_KNOT(V_SQRT(rsq), idx, p);
+
+      const vreal rho = V_FMA(V_FMA(V_FMA(V_GATHER(spline + 3, idx), p, V_GATHER(spline + 4, idx)), p,
+                                     V_GATHER(spline + 5, idx)), p, V_GATHER(spline + 6, idx));
+      rhoi = V_ADD(rhoi, V_MASKZ(mask, rho));
+    }
+
+    const MMD_float phi = FORCEEAM_SIMD_KERNEL(ForceEAM_embed)(force_eam, V_HSUM(rhoi), fp, i);
+
+    if(evflag) evdwl += phi;
+  }
+
+  // communicate derivative of embedding function
+
+  ForceEAM_communicate(force_eam, atom, comm);
+
+  // compute forces on each atom
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:evdwl,t_virial)
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[firstneigh[i]];
+    const int numneighs = (numneigh[i] + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    const vreal xtmp = V_SET1(x[i * PAD + 0]);
+    const vreal ytmp = V_SET1(x[i * PAD + 1]);
+    const vreal ztmp = V_SET1(x[i * PAD + 2]);
+    const vreal fpi = V_SET1(fp[i]);
+    const vreal cutforcesq = V_SET1(force_eam->cutforcesq);
+    const vreal rdr = V_SET1(force_eam->rdr);
+    const vreal one = V_SET1(1.0);
+    const vreal half = V_SET1(0.5);
+    vreal fx = V_ZERO();
+    vreal fy = V_ZERO();
+    vreal fz = V_ZERO();
+    vreal eng = V_ZERO();
+    vreal vir = V_ZERO();
+
+    for(int k = 0; k < numneighs; k += SIMD_WIDTH) {
+      const vindex jj = I_LOAD(&neighs[k]);
+      const vindex j = I_MULC(jj, PAD);
+      const vreal delx = V_SUB(xtmp, V_GATHER(x + 0, j));
+      const vreal dely = V_SUB(ytmp, V_GATHER(x + 1, j));
+      const vreal delz = V_SUB(ztmp, V_GATHER(x + 2, j));
+      const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+      const vmask mask = M_CUTOFF(rsq, cutforcesq);
+      const vreal r = V_SQRT(rsq);
+      vindex idx;
+      vreal p;
+
+      FORCEEAM_SIMD_KNOT(r, idx, p);
+
+      // see ForceEAM_compute_halfneigh for the meaning of the spline terms
+
+      const vreal rhoip = V_FMA(V_FMA(V_GATHER(spline + 0, idx), p, V_GATHER(spline + 1, idx)), p, V_GATHER(spline + 2, idx));
+      const vreal z2p = V_FMA(V_FMA(V_GATHER(spline + 8, idx), p, V_GATHER(spline + 9, idx)), p, V_GATHER(spline + 10, idx));
+      const vreal z2 = V_FMA(V_FMA(V_FMA(V_GATHER(spline + 11, idx), p, V_GATHER(spline + 12, idx)), p,
+                                    V_GATHER(spline + 13, idx)), p, V_GATHER(spline + 14, idx));
+
+      const vreal recip = V_DIV(one, r);
+      const vreal phi = V_MUL(z2, recip);
+      const vreal phip = V_SUB(V_MUL(z2p, recip), V_MUL(phi, recip));
+      const vreal psip = V_FMA(V_ADD(fpi, V_GATHER(fp, jj)), rhoip, phip);
+      const vreal fpair = V_MASKZ(mask, V_SUB(V_ZERO(), V_MUL(psip, recip)));
+
+      fx = V_FMA(delx, fpair, fx);
+      fy = V_FMA(dely, fpair, fy);
+      fz = V_FMA(delz, fpair, fz);
+
+      if(evflag) {
+        eng = V_ADD(eng, V_MASKZ(mask, V_MUL(half, phi)));
+        vir = V_FMA(rsq, V_MUL(half, fpair), vir);
+      }
+    }
+
+    f[i * PAD + 0] = V_HSUM(fx);
+    f[i * PAD + 1] = V_HSUM(fy);
+    f[i * PAD + 2] = V_HSUM(fz);
+
+    if(evflag) {
+      evdwl += V_HSUM(eng);
+      t_virial += V_HSUM(vir);
+    }
+  }
+
+  force_eam->eng_vdwl = 2.0 * evdwl;
+  force_eam->virial = t_virial;
+}
+
+//cluster pair lists (Neighbor_build_clusters)
+//  -MPI + OpenMP over the local i-clusters, CLUSTER_M x SIMD_WIDTH tiles
+//  -j positions are aligned vector loads, fp[j] is gathered through the
+//   cluster slots (padding slots read fp[0] and drop out of the mask)
+SIMD_TARGET
+void FORCEEAM_SIMD_KERNEL(ForceEAM_compute_cluster)(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor, Comm *comm, int me)
+{
+  if(atom->nmax > force_eam->nmax) {
+    force_eam->nmax = atom->nmax;
+    free(force_eam->fp);
+    force_eam->fp = (MMD_float *) malloc(sizeof(MMD_float) * force_eam->nmax);
+  }
+
+  const int nclusters = neighbor->nlocal_clusters;
+  const int maxneighs = neighbor->max_cluster_neighs;
+  const int nthreads = force_eam->threads->omp_num_threads;
+  const int evflag = force_eam->evflag;
+  const int cpj = SIMD_WIDTH / CLUSTER_M;
+  MMD_float* const restrict f = &atom->f[0][0];
+  const MMD_float* const restrict cx = neighbor->cluster_x;
+  const int* const restrict cluster_atoms = neighbor->cluster_atoms;
+  const int* const restrict cluster_neighbors = neighbor->cluster_neighbors;
+  const int* const restrict cluster_numneigh = neighbor->cluster_numneigh;
+  const MMD_float* const restrict spline = force_eam->pair_spline;
+  MMD_float* const restrict fp = force_eam->fp;
+
+  MMD_float evdwl = 0;
+  MMD_float t_virial = 0;
+
+  Neighbor_update_clusters(neighbor, atom);
+
+  // rho = density at each atom, fp = derivative of embedding energy
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:evdwl)
+  for(int ic = 0; ic < nclusters; ic++) {
+    const int* const neighs = &cluster_neighbors[ic * maxneighs];
+    const int numneighs = cluster_numneigh[ic];
+    const MMD_float* const xi = &cx[(ic / cpj) * 3 * SIMD_WIDTH + (ic % cpj) * CLUSTER_M];
+    const vreal cutforcesq = V_SET1(force_eam->cutforcesq);
+    const vreal rdr = V_SET1(force_eam->rdr);
+    const vreal one = V_SET1(1.0);
+    vreal xtmp[CLUSTER_M], ytmp[CLUSTER_M], ztmp[CLUSTER_M], rhoi[CLUSTER_M];
+
+    #pragma GCC unroll 4
+    for(int m = 0; m < CLUSTER_M; m++) {
+      xtmp[m] = V_SET1(xi[0 * SIMD_WIDTH + m]);
+      ytmp[m] = V_SET1(xi[1 * SIMD_WIDTH + m]);
+      ztmp[m] = V_SET1(xi[2 * SIMD_WIDTH + m]);
+      rhoi[m] = V_ZERO();
+    }
+
+    for(int k = 0; k < numneighs; k++) {
+      const MMD_float* const xj = &cx[neighs[k] * 3 * SIMD_WIDTH];
+      const vreal xjv = V_LOAD(xj + 0 * SIMD_WIDTH);
+      const vreal yjv = V_LOAD(xj + 1 * SIMD_WIDTH);
+      const vreal zjv = V_LOAD(xj + 2 * SIMD_WIDTH);
+
+      #pragma GCC unroll 4
+      for(int m = 0; m < CLUSTER_M; m++) {
+        const vreal delx = V_SUB(xtmp[m], xjv);
+        const vreal dely = V_SUB(ytmp[m], yjv);
+        const vreal delz = V_SUB(ztmp[m], zjv);
+        const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+        const vmask mask = M_CUTOFF(rsq, cutforcesq);
+        vindex idx;
+        vreal p;
+
+        FORCEEAM_SIMD_KNOT(V_SQRT(rsq), idx, p);
+
+        const vreal rho = V_FMA(V_FMA(V_FMA(V_GATHER(spline + 3, idx), p, V_GATHER(spline + 4, idx)), p,
+                                       V_GATHER(spline + 5, idx)), p, V_GATHER(spline + 6, idx));
+        rhoi[m] = V_ADD(rhoi[m], V_MASKZ(mask, rho));
+      }
+    }
+
+    for(int m = 0; m < CLUSTER_M; m++) {
+      const int i = cluster_atoms[ic * CLUSTER_M + m];
+
+      if(i < 0) continue;
+
+      const MMD_float phi = FORCEEAM_SIMD_KERNEL(ForceEAM_embed)(force_eam, V_HSUM(rhoi[m]), fp, i);
+
+      if(evflag) evdwl += phi;
+    }
+  }
+
+  // communicate derivative of embedding function
+
+  ForceEAM_communicate(force_eam, atom, comm);
+
+  // compute forces on each atom
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:evdwl,t_virial)
+  for(int ic = 0; ic < nclusters; ic++) {
+    const int* const neighs = &cluster_neighbors[ic * maxneighs];
+    const int numneighs = cluster_numneigh[ic];
+    const MMD_float* const xi = &cx[(ic / cpj) * 3 * SIMD_WIDTH + (ic % cpj) * CLUSTER_M];
+    const vreal cutforcesq = V_SET1(force_eam->cutforcesq);
+    const vreal rdr = V_SET1(force_eam->rdr);
+    const vreal one = V_SET1(1.0);
+    const vreal half = V_SET1(0.5);
+    vreal xtmp[CLUSTER_M], ytmp[CLUSTER_M], ztmp[CLUSTER_M], fpi[CLUSTER_M];
+    vreal fx[CLUSTER_M], fy[CLUSTER_M], fz[CLUSTER_M];
+    vreal eng = V_ZERO();
+    vreal vir = V_ZERO();
+
+    #pragma GCC unroll 4
+    for(int m = 0; m < CLUSTER_M; m++) {
+      const int i = cluster_atoms[ic * CLUSTER_M + m];
+      xtmp[m] = V_SET1(xi[0 * SIMD_WIDTH + m]);
+      ytmp[m] = V_SET1(xi[1 * SIMD_WIDTH + m]);
+      ztmp[m] = V_SET1(xi[2 * SIMD_WIDTH + m]);
+      fpi[m] = V_SET1(i < 0 ? 0.0 : fp[i]);
+      fx[m] = fy[m] = fz[m] = V_ZERO();
+    }
+
+    for(int k = 0; k < numneighs; k++) {
+      const int jc = neighs[k];
+      const MMD_float* const xj = &cx[jc * 3 * SIMD_WIDTH];
+      const vreal xjv = V_LOAD(xj + 0 * SIMD_WIDTH);
+      const vreal yjv = V_LOAD(xj + 1 * SIMD_WIDTH);
+      const vreal zjv = V_LOAD(xj + 2 * SIMD_WIDTH);
+      const vreal fpj = V_GATHER(fp, I_MAX(I_LOAD(&cluster_atoms[jc * SIMD_WIDTH]), I_SET1(0)));
+
+      #pragma GCC unroll 4
+      for(int m = 0; m < CLUSTER_M; m++) {
+        const vreal delx = V_SUB(xtmp[m], xjv);
+        const vreal dely = V_SUB(ytmp[m], yjv);
+        const vreal delz = V_SUB(ztmp[m], zjv);
+        const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+        const vmask mask = M_CUTOFF(rsq, cutforcesq);
+        const vreal r = V_SQRT(rsq);
+        vindex idx;
+        vreal p;
+
+        FORCEEAM_SIMD_KNOT(r, idx, p);
+
+        // see ForceEAM_compute_halfneigh for the meaning of the spline terms
+
+        const vreal rhoip = V_FMA(V_FMA(V_GATHER(spline + 0, idx), p, V_GATHER(spline + 1, idx)), p, V_GATHER(spline + 2, idx));
+        const vreal z2p = V_FMA(V_FMA(V_GATHER(spline + 8, idx), p, V_GATHER(spline + 9, idx)), p, V_GATHER(spline + 10, idx));
+        const vreal z2 = V_FMA(V_FMA(V_FMA(V_GATHER(spline + 11, idx), p, V_GATHER(spline + 12, idx)), p,
+                                      V_GATHER(spline + 13, idx)), p, V_GATHER(spline + 14, idx));
+
+        const vreal recip = V_DIV(one, r);
+        const vreal phi = V_MUL(z2, recip);
+        const vreal phip = V_SUB(V_MUL(z2p, recip), V_MUL(phi, recip));
+        const vreal psip = V_FMA(V_ADD(fpi[m], fpj), rhoip, phip);
+        const vreal fpair = V_MASKZ(mask, V_SUB(V_ZERO(), V_MUL(psip, recip)));
+
+        fx[m] = V_FMA(delx, fpair, fx[m]);
+        fy[m] = V_FMA(dely, fpair, fy[m]);
+        fz[m] = V_FMA(delz, fpair, fz[m]);
+
+        if(evflag) {
+          eng = V_ADD(eng, V_MASKZ(mask, V_MUL(half, phi)));
+          vir = V_FMA(rsq, V_MUL(half, fpair), vir);
+        }
+      }
+    }
+
+    for(int m = 0; m < CLUSTER_M; m++) {
+      const int i = cluster_atoms[ic * CLUSTER_M + m];
+
+      if(i < 0) continue;
+
+      f[i * PAD + 0] = V_HSUM(fx[m]);
+      f[i * PAD + 1] = V_HSUM(fy[m]);
+      f[i * PAD + 2] = V_HSUM(fz[m]);
+    }
+
+    if(evflag) {
+      evdwl += V_HSUM(eng);
+      t_virial += V_HSUM(vir);
+    }
+  }
+
+  force_eam->eng_vdwl = 2.0 * evdwl;
+  force_eam->virial = t_virial;
+}
+
+//half neighborlists (ghost_newton 0)
+//  -MPI only, the threaded half neighborlist variants stay scalar
+//  -pair terms are vectorized, rho[j] and f[j] are updated per lane
+SIMD_TARGET
+void FORCEEAM_SIMD_KERNEL(ForceEAM_compute_halfneigh)(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor, Comm *comm, int me)
+{
+  if(atom->nmax > force_eam->nmax) {
+    force_eam->nmax = atom->nmax;
+    free(force_eam->rho);
+    free(force_eam->fp);
+
+    force_eam->rho = (MMD_float *) malloc(sizeof(MMD_float) * force_eam->nmax);
+    force_eam->fp  = (MMD_float *) malloc(sizeof(MMD_float) * force_eam->nmax);
+  }
+
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const int* const restrict firstneigh = neighbor->firstneigh;
+  const int evflag = force_eam->evflag;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  const int* const restrict neighbors = neighbor->neighbors;
+  const int* const restrict numneigh = neighbor->numneigh;
+  const MMD_float* const restrict spline = force_eam->pair_spline;
+  MMD_float* const restrict rho = force_eam->rho;
+  MMD_float* const restrict fp = force_eam->fp;
+  const vreal cutforcesq = V_SET1(force_eam->cutforcesq);
+  const vreal rdr = V_SET1(force_eam->rdr);
+  const vreal one = V_SET1(1.0);
+
+  MMD_float tdelx[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tdely[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tdelz[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tval[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tphi[SIMD_WIDTH] __attribute__((aligned(64)));
+
+  MMD_float evdwl = 0;
+  MMD_float t_virial = 0;
+
+  for(int i = 0; i < nlocal; i++) rho[i] = 0.0;
+
+  // rho = density at each atom
+
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[firstneigh[i]];
+    const int numneighs = (numneigh[i] + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    const vreal xtmp = V_SET1(x[i * PAD + 0]);
+    const vreal ytmp = V_SET1(x[i * PAD + 1]);
+    const vreal ztmp = V_SET1(x[i * PAD + 2]);
+    vreal rhoi = V_ZERO();
+
+    for(int k = 0; k < numneighs; k += SIMD_WIDTH) {
+      const vindex j = I_MULC(I_LOAD(&neighs[k]), PAD);
+      const vreal delx = V_SUB(xtmp, V_GATHER(x + 0, j));
+      const vreal dely = V_SUB(ytmp, V_GATHER(x + 1, j));
+      const vreal delz = V_SUB(ztmp, V_GATHER(x + 2, j));
+      const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+      const vmask mask = M_CUTOFF(rsq, cutforcesq);
+      vindex idx;
+      vreal p;
+
+      FORCEEAM_SIMD_KNOT(V_SQRT(rsq), idx, p);
+
+      const vreal rhoij = V_MASKZ(mask, V_FMA(V_FMA(V_FMA(V_GATHER(spline + 3, idx), p, V_GATHER(spline + 4, idx)), p,
+                                                     V_GATHER(spline + 5, idx)), p, V_GATHER(spline + 6, idx)));
+      rhoi = V_ADD(rhoi, rhoij);
+      V_STORE(tval, rhoij);
+
+      for(int l = 0; l < SIMD_WIDTH; l++) {
+        const int jl = neighs[k + l];
+
+        if(jl < nlocal) rho[jl] += tval[l];
+      }
+    }
+
+    rho[i] += V_HSUM(rhoi);
+  }
+
+  // fp = derivative of embedding energy at each atom
+
+  for(int i = 0; i < nlocal; i++) {
+    const MMD_float phi = FORCEEAM_SIMD_KERNEL(ForceEAM_embed)(force_eam, rho[i], fp, i);
+
+    if(evflag) evdwl += phi;
+  }
+
+  // communicate derivative of embedding function
+
+  ForceEAM_communicate(force_eam, atom, comm);
+
+  for(int i = 0; i < nall * PAD; i++)
+    f[i] = 0.0;
+
+  // compute forces on each atom
+
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[firstneigh[i]];
+    const int numneighs = (numneigh[i] + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    const vreal xtmp = V_SET1(x[i * PAD + 0]);
+    const vreal ytmp = V_SET1(x[i * PAD + 1]);
+    const vreal ztmp = V_SET1(x[i * PAD + 2]);
+    const vreal fpi = V_SET1(fp[i]);
+    vreal fx = V_ZERO();
+    vreal fy = V_ZERO();
+    vreal fz = V_ZERO();
+
+    for(int k = 0; k < numneighs; k += SIMD_WIDTH) {
+      const vindex jj = I_LOAD(&neighs[k]);
+      const vindex j = I_MULC(jj, PAD);
+      const vreal delx = V_SUB(xtmp, V_GATHER(x + 0, j));
+      const vreal dely = V_SUB(ytmp, V_GATHER(x + 1, j));
+      const vreal delz = V_SUB(ztmp, V_GATHER(x + 2, j));
+      const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+      const vmask mask = M_CUTOFF(rsq, cutforcesq);
+      const vreal r = V_SQRT(rsq);
+      vindex idx;
+      vreal p;
+
+      FORCEEAM_SIMD_KNOT(r, idx, p);
+
+      const vreal rhoip = V_FMA(V_FMA(V_GATHER(spline + 0, idx), p, V_GATHER(spline + 1, idx)), p, V_GATHER(spline + 2, idx));
+      const vreal z2p = V_FMA(V_FMA(V_GATHER(spline + 8, idx), p, V_GATHER(spline + 9, idx)), p, V_GATHER(spline + 10, idx));
+      const vreal z2 = V_FMA(V_FMA(V_FMA(V_GATHER(spline + 11, idx), p, V_GATHER(spline + 12, idx)), p,
+                                    V_GATHER(spline + 13, idx)), p, V_GATHER(spline + 14, idx));
+
+      const vreal recip = V_DIV(one, r);
+      const vreal phi = V_MUL(z2, recip);
+      const vreal phip = V_SUB(V_MUL(z2p, recip), V_MUL(phi, recip));
+      const vreal psip = V_FMA(V_ADD(fpi, V_GATHER(fp, jj)), rhoip, phip);
+      const vreal fpair = V_MASKZ(mask, V_SUB(V_ZERO(), V_MUL(psip, recip)));
+
+      fx = V_FMA(delx, fpair, fx);
+      fy = V_FMA(dely, fpair, fy);
+      fz = V_FMA(delz, fpair, fz);
+
+      V_STORE(tdelx, delx);
+      V_STORE(tdely, dely);
+      V_STORE(tdelz, delz);
+      V_STORE(tval, fpair);
+
+      if(evflag)
+        V_STORE(tphi, V_MASKZ(mask, phi));
+
+      for(int l = 0; l < SIMD_WIDTH; l++) {
+        const int jl = neighs[k + l];
+        const MMD_float scale = jl < nlocal ? 1.0 : 0.5;
+
+        if(jl < nlocal) {
+          f[jl * PAD + 0] -= tdelx[l] * tval[l];
+          f[jl * PAD + 1] -= tdely[l] * tval[l];
+          f[jl * PAD + 2] -= tdelz[l] * tval[l];
+        }
+
+        if(evflag) {
+          t_virial += scale * (tdelx[l] * tdelx[l] + tdely[l] * tdely[l] + tdelz[l] * tdelz[l]) * tval[l];
+          evdwl += scale * tphi[l];
+        }
+      }
+    }
+
+    f[i * PAD + 0] += V_HSUM(fx);
+    f[i * PAD + 1] += V_HSUM(fy);
+    f[i * PAD + 2] += V_HSUM(fz);
+  }
+
+  force_eam->eng_vdwl = evdwl;
+  force_eam->virial = t_virial;
+}
@@ -0,0 +1,339 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+/* threaded half neighborlist kernel of ForceEAM, included by force_eam.c
+   once per HALF_ATOMIC: the _atomic variant updates rho[j] and f[j] with
+   OpenMP atomics, the other one runs the thread private copies or the
+   colored blocks, without a branch in the pair loop */
+
+#undef FORCEEAM_THREADED
+#if HALF_ATOMIC
+#define FORCEEAM_THREADED(name) name##_atomic
+#else
+#define FORCEEAM_THREADED(name) name
+#endif
+
+// density of atom i and its half list partners j < nlocal, summed into rhot
+// (a thread private copy, or the shared rho if the update is atomic or colored)
+
+static inline void FORCEEAM_THREADED(ForceEAM_density_atom)(const ForceEAM *force_eam, const Neighbor *neighbor, const MMD_float* const restrict x,
+                                                            MMD_float* const restrict rhot, const int i, const int nlocal)
+{
+  const int* const neighs = &neighbor->neighbors[FIRSTNEIGH(neighbor->firstneigh, i)];
+  const int numneigh = neighbor->numneigh[i];
+  const MMD_pfloat* const restrict rhor_spline = force_eam->rhor_spline;
+  const MMD_pfloat rdr = force_eam->rdr;
+  const MMD_float xtmp = x[i * PAD + 0];
+  const MMD_float ytmp = x[i * PAD + 1];
+  const MMD_float ztmp = x[i * PAD + 2];
+  MMD_float rhoi = 0.0;
+
+  for(MMD_int jj = 0; jj < numneigh; jj++) {
+    const MMD_int j = neighs[jj * DS1(neighbor->nmax,neighbor->maxneighs)];
+
+    const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+    const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+    const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+    const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+
+    if(rsq < force_eam->cutforcesq) {
+      MMD_pfloat p = sqrt(rsq) * rdr + 1.0f;
+      MMD_int m = (int)(p);
+      m = m < force_eam->nr - 1 ? m : force_eam->nr - 1;
+      p -= m;
+      p = p < 1.0f ? p : 1.0f;
+
+      const MMD_pfloat rhoij = ((rhor_spline[m * 7 + 3] * p + rhor_spline[m * 7 + 4]) * p + rhor_spline[m * 7 + 5]) * p + rhor_spline[m * 7 + 6];
+
+      rhoi += rhoij;
+
+      if(j < nlocal) {
+#if HALF_ATOMIC
+        #pragma omp atomic
+#endif
+        rhot[j] += rhoij;
+      }
+    }
+  }
+
+#if HALF_ATOMIC
+  #pragma omp atomic
+#endif
+  rhot[i] += rhoi;
+}
+
+// pair and embedding forces of atom i and its half list partners j < nlocal, summed into fthr
+
+static inline void FORCEEAM_THREADED(ForceEAM_force_atom)(const ForceEAM *force_eam, const Neighbor *neighbor, const MMD_float* const restrict x,
+                                                          MMD_float* const restrict fthr, const int i, const int nlocal,
+                                                          MMD_float* evdwl, MMD_float* virial)
+{
+  const int* const neighs = &neighbor->neighbors[FIRSTNEIGH(neighbor->firstneigh, i)];
+  const int numneigh = neighbor->numneigh[i];
+  const MMD_float* const restrict fp = force_eam->fp;
+  const MMD_pfloat* const restrict rhor_spline = force_eam->rhor_spline;
+  const MMD_pfloat* const restrict z2r_spline = force_eam->z2r_spline;
+  const MMD_pfloat rdr = force_eam->rdr;
+  const MMD_float xtmp = x[i * PAD + 0];
+  const MMD_float ytmp = x[i * PAD + 1];
+  const MMD_float ztmp = x[i * PAD + 2];
+  MMD_float fx = 0;
+  MMD_float fy = 0;
+  MMD_float fz = 0;
+  MMD_float t_evdwl = 0;
+  MMD_float t_virial = 0;
+
+  for(MMD_int jj = 0; jj < numneigh; jj++) {
+    const MMD_int j = neighs[jj * DS1(neighbor->nmax,neighbor->maxneighs)];
+
+    const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+    const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+    const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+    const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+
+    if(rsq < force_eam->cutforcesq) {
+      MMD_pfloat r = sqrt(rsq);
+      MMD_pfloat p = r * rdr + 1.0f;
+      MMD_int m = (int)(p);
+      m = m < force_eam->nr - 1 ? m : force_eam->nr - 1;
+      p -= m;
+      p = p < 1.0f ? p : 1.0f;
+
+      // see ForceEAM_compute_halfneigh for the meaning of the spline terms
+
+      MMD_pfloat rhoip = (rhor_spline[m * 7 + 0] * p + rhor_spline[m * 7 + 1]) * p + rhor_spline[m * 7 + 2];
+      MMD_pfloat z2p = (z2r_spline[m * 7 + 0] * p + z2r_spline[m * 7 + 1]) * p + z2r_spline[m * 7 + 2];
+      MMD_pfloat z2 = ((z2r_spline[m * 7 + 3] * p + z2r_spline[m * 7 + 4]) * p + z2r_spline[m * 7 + 5]) * p + z2r_spline[m * 7 + 6];
+
+      MMD_pfloat recip = 1.0f / r;
+      MMD_pfloat phi = z2 * recip;
+      MMD_pfloat phip = z2p * recip - phi * recip;
+      MMD_pfloat psip = (MMD_pfloat) fp[i] * rhoip + (MMD_pfloat) fp[j] * rhoip + phip;
+      MMD_pfloat fpair = -psip * recip;
+
+      fx += delx * fpair;
+      fy += dely * fpair;
+      fz += delz * fpair;
+
+      if(j < nlocal) {
+#if HALF_ATOMIC
+        #pragma omp atomic
+        fthr[j * PAD + 0] -= delx * fpair;
+        #pragma omp atomic
+        fthr[j * PAD + 1] -= dely * fpair;
+        #pragma omp atomic
+        fthr[j * PAD + 2] -= delz * fpair;
+#else
+        fthr[j * PAD + 0] -= delx * fpair;
+        fthr[j * PAD + 1] -= dely * fpair;
+        fthr[j * PAD + 2] -= delz * fpair;
+#endif
+      } else fpair *= 0.5f;
+
+      if(force_eam->evflag) {
+        t_virial += delx * delx * fpair + dely * dely * fpair + delz * delz * fpair;
+        t_evdwl += j < nlocal ? phi : 0.5 * phi;
+      }
+    }
+  }
+
+#if HALF_ATOMIC
+  #pragma omp atomic
+  fthr[i * PAD + 0] += fx;
+  #pragma omp atomic
+  fthr[i * PAD + 1] += fy;
+  #pragma omp atomic
+  fthr[i * PAD + 2] += fz;
+#else
+  fthr[i * PAD + 0] += fx;
+  fthr[i * PAD + 1] += fy;
+  fthr[i * PAD + 2] += fz;
+#endif
+
+  *evdwl += t_evdwl;
+  *virial += t_virial;
+}
+
+//threaded version of ForceEAM_compute_halfneigh
+//  -MPI + OpenMP (half neighborlists)
+//  -rho[j] and f[j] updates follow force_eam->half_threading:
+//   OpenMP atomics (HALFNEIGH_ATOMIC, the _atomic variant), thread private copies
+//   reduced afterwards (HALFNEIGH_PRIVATE) or the colored bin blocks of
+//   Neighbor_build_colors (HALFNEIGH_COLOR)
+//  -the private copies of rho and f share the f_thread buffer, only local atoms are touched
+//   since EAM runs with ghost_newton 0
+//  -fp is communicated between the two parallel regions by the master thread only
+void FORCEEAM_THREADED(ForceEAM_compute_halfneigh_threaded)(ForceEAM *force_eam, Atom *atom, Neighbor *neighbor, Comm *comm, int me)
+{
+  // grow energy and fp arrays if necessary
+  // need to be atom->nmax in length
+
+  if(atom->nmax > force_eam->nmax) {
+    force_eam->nmax = atom->nmax;
+    free(force_eam->rho);
+    free(force_eam->fp);
+
+    force_eam->rho = (MMD_float *) malloc(sizeof(MMD_float) * force_eam->nmax);
+    force_eam->fp  = (MMD_float *) malloc(sizeof(MMD_float) * force_eam->nmax);
+  }
+
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const int nthreads = force_eam->threads->omp_num_threads;
+  const int use_color = !HALF_ATOMIC && force_eam->half_threading == HALFNEIGH_COLOR && neighbor->bincolor;
+  const int use_private = !HALF_ATOMIC && !use_color;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  MMD_float* const restrict rho = force_eam->rho;
+  MMD_float* const restrict fp = force_eam->fp;
+  const int* const restrict block_start = neighbor->block_start;
+  const int* const restrict block_atoms = neighbor->block_atoms;
+
+  if(use_private)
+    ForceEAM_grow_fthread(force_eam, nthreads * nlocal * PAD);
+
+  MMD_float* const restrict f_thread = force_eam->f_thread;
+
+  MMD_float evdwl = 0.0;
+  MMD_float t_virial = 0.0;
+
+  // rho = density at each atom
+  // fp = derivative of embedding energy at each atom
+  // phi = embedding energy at each atom
+
+  #pragma omp parallel num_threads(nthreads) reduction(+:evdwl)
+  {
+    const int tid = omp_get_thread_num();
+    const int nthr = omp_get_num_threads();
+    MMD_float* const restrict rhot = use_private ? &f_thread[tid * nlocal] : rho;
+
+    if(use_private) {
+      for(int i = 0; i < nlocal; i++) rhot[i] = 0.0;
+    } else {
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nlocal; i++) rho[i] = 0.0;
+    }
+
+    #pragma omp barrier
+
+    if(use_color) {
+      for(int c = 0; c < 8; c++) {
+        #pragma omp for schedule(dynamic,1)
+        for(int b = neighbor->color_start[c]; b < neighbor->color_start[c + 1]; b++)
+          for(int ii = block_start[b]; ii < block_start[b + 1]; ii++)
+            FORCEEAM_THREADED(ForceEAM_density_atom)(force_eam, neighbor, x, rhot, block_atoms[ii], nlocal);
+      }
+    } else {
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nlocal; i++)
+        FORCEEAM_THREADED(ForceEAM_density_atom)(force_eam, neighbor, x, rhot, i, nlocal);
+    }
+
+    if(use_private) {
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nlocal; i++) {
+        MMD_float sum = 0.0;
+
+        for(int t = 0; t < nthr; t++)
+          sum += f_thread[t * nlocal + i];
+
+        rho[i] = sum;
+      }
+    }
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nlocal; i++) {
+      MMD_float p = 1.0 * rho[i] * force_eam->rdrho + 1.0;
+      MMD_int m = (int)(p);
+      m = MAX(1, MIN(m, force_eam->nrho - 1));
+      p -= m;
+      p = MIN(p, 1.0);
+      fp[i] = (force_eam->frho_spline[m * 7 + 0] * p + force_eam->frho_spline[m * 7 + 1]) * p + force_eam->frho_spline[m * 7 + 2];
+
+      if(force_eam->evflag) {
+        evdwl += ((force_eam->frho_spline[m * 7 + 3] * p + force_eam->frho_spline[m * 7 + 4]) * p + force_eam->frho_spline[m * 7 + 5]) * p + force_eam->frho_spline[m * 7 + 6];
+      }
+    }
+  }
+
+  // communicate derivative of embedding function
+
+  ForceEAM_communicate(force_eam, atom, comm);
+
+  // compute forces on each atom
+  // loop over neighbors of my atoms
+
+  #pragma omp parallel num_threads(nthreads) reduction(+:evdwl,t_virial)
+  {
+    const int tid = omp_get_thread_num();
+    const int nthr = omp_get_num_threads();
+    MMD_float* const restrict fthr = use_private ? &f_thread[tid * nlocal * PAD] : f;
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nall * PAD; i++)
+      f[i] = 0.0;
+
+    if(use_private)
+      for(int i = 0; i < nlocal * PAD; i++) fthr[i] = 0.0;
+
+    #pragma omp barrier
+
+    if(use_color) {
+      for(int c = 0; c < 8; c++) {
+        #pragma omp for schedule(dynamic,1)
+        for(int b = neighbor->color_start[c]; b < neighbor->color_start[c + 1]; b++)
+          for(int ii = block_start[b]; ii < block_start[b + 1]; ii++)
+            FORCEEAM_THREADED(ForceEAM_force_atom)(force_eam, neighbor, x, fthr, block_atoms[ii], nlocal, &evdwl, &t_virial);
+      }
+    } else {
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nlocal; i++)
+        FORCEEAM_THREADED(ForceEAM_force_atom)(force_eam, neighbor, x, fthr, i, nlocal, &evdwl, &t_virial);
+    }
+
+    // sum up the thread private copies, every thread reduces a slice of f
+
+    if(use_private) {
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nlocal * PAD; i++) {
+        MMD_float sum = 0.0;
+
+        for(int t = 0; t < nthr; t++)
+          sum += f_thread[t * nlocal * PAD + i];
+
+        f[i] = sum;
+      }
+    }
+  }
+
+  force_eam->eng_vdwl = evdwl;
+  force_eam->virial = t_virial;
+}
@@ -50,17 +50,27 @@ typedef Force ForceLJ;
 
 ForceLJ *ForceLJ_alloc();
 void ForceLJ_free(ForceLJ *);
-void ForceLJ_setup(ForceLJ *force, Atom * atom);
+void ForceLJ_setup(ForceLJ *force, Atom * atom, Neighbor *neighbor);
 void ForceLJ_compute(ForceLJ *, Atom *, Neighbor *, Comm *, int);
-
-//template<int EVFLAG>
-void ForceLJ_compute_original(ForceLJ *, Atom *, Neighbor *, int, int);
-//template<int EVFLAG, int GHOST_NEWTON>
-void ForceLJ_compute_halfneigh(ForceLJ *, Atom *, Neighbor *, int, int, int);
-//template<int EVFLAG, int GHOST_NEWTON>
-void ForceLJ_compute_halfneigh_threaded(ForceLJ *, Atom *, Neighbor *, int, int, int);
-//template<int EVFLAG>
-void ForceLJ_compute_fullneigh(ForceLJ *, Atom *, Neighbor *, int, int);
+void ForceLJ_compute_overlap(ForceLJ *, Atom *, Neighbor *, Comm *, int);
+void ForceLJ_grow_fthread(ForceLJ *, int);
+
+// the kernels themselves are generated from force_lj_kernels.h,
+// one per EVFLAG / GHOST_NEWTON combination, and picked in ForceLJ_setup
+
+// intrinsics kernels from force_lj_simd.c (force_lj_simd.h per ISA and EVFLAG)
+void ForceLJ_compute_fullneigh_avx2_e0(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_fullneigh_avx2_e1(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_halfneigh_avx2_e0(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_halfneigh_avx2_e1(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_fullneigh_avx512_e0(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_fullneigh_avx512_e1(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_halfneigh_avx512_e0(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_halfneigh_avx512_e1(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_cluster_avx2_e0(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_cluster_avx2_e1(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_cluster_avx512_e0(ForceLJ *, Atom *, Neighbor *, int);
+void ForceLJ_compute_cluster_avx512_e1(ForceLJ *, Atom *, Neighbor *, int);
 
 #endif
 
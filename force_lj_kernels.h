@@ -0,0 +1,448 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+/* force kernels of ForceLJ, included once per EVFLAG / GHOST_NEWTON
+   combination by force_lj.c (this replaces the template parameters of the
+   original C++ version); the kernels without a GHOST_NEWTON dependency
+   are only generated for GHOST_NEWTON 0 */
+
+#define FORCELJ_PASTE_EV(name, e) name##_e##e
+#define FORCELJ_PASTE(name, g, e) name##_g##g##_e##e
+#define FORCELJ_NAME_EV(name, e) FORCELJ_PASTE_EV(name, e)
+#define FORCELJ_NAME(name, g, e) FORCELJ_PASTE(name, g, e)
+#define FORCELJ_KERNEL_EV(name) FORCELJ_NAME_EV(name, EVFLAG)
+#define FORCELJ_KERNEL(name) FORCELJ_NAME(name, GHOST_NEWTON, EVFLAG)
+
+#if !GHOST_NEWTON
+//original version of force compute in miniMD
+//  -MPI only
+//  -not vectorizable
+static void FORCELJ_KERNEL_EV(ForceLJ_compute_original)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  int i, j, k, nlocal, nall, numneigh;
+  MMD_float xtmp, ytmp, ztmp, delx, dely, delz, rsq;
+  MMD_float sr2, sr6, force;
+  int* neighs;
+  MMD_float** x, **f;
+
+  nlocal = atom->nlocal;
+  nall = atom->nlocal + atom->nghost;
+  x = atom->x;
+  f = atom->f;
+
+  force_lj->eng_vdwl = 0;
+  force_lj->virial = 0;
+  // clear force on own and ghost atoms
+
+  for(i = 0; i < nall; i++) {
+    f[i][0] = 0.0;
+    f[i][1] = 0.0;
+    f[i][2] = 0.0;
+  }
+
+  // loop over all neighbors of my atoms
+  // store force on both atoms i and j
+
+  for(i = 0; i < nlocal; i++) {
+    neighs = &neighbor->neighbors[FIRSTNEIGH(neighbor->firstneigh, i)];
+    numneigh = neighbor->numneigh[i];
+    xtmp = x[i][0];
+    ytmp = x[i][1];
+    ztmp = x[i][2];
+
+    for(k = 0; k < numneigh; k++) {
+      j = neighs[k * DS1(neighbor->nmax, neighbor->maxneighs)];
+      delx = xtmp - x[j][0];
+      dely = ytmp - x[j][1];
+      delz = ztmp - x[j][2];
+      rsq = delx * delx + dely * dely + delz * delz;
+
+      if(rsq < force_lj->cutforcesq) {
+        sr2 = 1.0 / rsq;
+        sr6 = sr2 * sr2 * sr2 * force_lj->sigma6;
+        force = 48.0 * sr6 * (sr6 - 0.5) * sr2 * force_lj->epsilon;
+        f[i][0] += delx * force;
+        f[i][1] += dely * force;
+        f[i][2] += delz * force;
+        f[j][0] -= delx * force;
+        f[j][1] -= dely * force;
+        f[j][2] -= delz * force;
+
+        if(EVFLAG) {
+          force_lj->eng_vdwl += (4.0 * sr6 * (sr6 - 1.0)) * force_lj->epsilon;
+          force_lj->virial += (delx * delx + dely * dely + delz * delz) * force;
+        }
+      }
+    }
+  }
+}
+
+#endif
+
+
+//optimised version of compute
+//  -MPI only
+//  -use temporary variable for summing up fi
+//  -enables vectorization by:
+//     -getting rid of 2d pointers
+//     -use pragma simd to force vectorization of inner loop
+static void FORCELJ_KERNEL(ForceLJ_compute_halfneigh)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  int* neighs;
+
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  MMD_float* x = &atom->x[0][0];
+  MMD_float* f = &atom->f[0][0];
+  const MMD_pfloat sigma6 = force_lj->sigma6;
+  const MMD_pfloat epsilon = force_lj->epsilon;
+  const MMD_pfloat cutforcesq = force_lj->cutforcesq;
+
+  // clear force on own and ghost atoms
+  for(int i = 0; i < nall; i++) {
+    f[i * PAD + 0] = 0.0;
+    f[i * PAD + 1] = 0.0;
+    f[i * PAD + 2] = 0.0;
+  }
+
+  // loop over all neighbors of my atoms
+  // store force on both atoms i and j
+  MMD_float t_energy = 0;
+  MMD_float t_virial = 0;
+
+  for(int i = 0; i < nlocal; i++) {
+    neighs = &neighbor->neighbors[FIRSTNEIGH(neighbor->firstneigh, i)];
+    const int numneighs = neighbor->numneigh[i];
+    const MMD_float xtmp = x[i * PAD + 0];
+    const MMD_float ytmp = x[i * PAD + 1];
+    const MMD_float ztmp = x[i * PAD + 2];
+
+    MMD_float fix = 0.0;
+    MMD_float fiy = 0.0;
+    MMD_float fiz = 0.0;
+
+#ifdef USE_SIMD
+    #pragma simd reduction (+: fix,fiy,fiz)
+#endif
+    for(int k = 0; k < numneighs; k++) {
+      const int j = neighs[k * DS1(neighbor->nmax, neighbor->maxneighs)];
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+
+      if(rsq < cutforcesq) {
+        const MMD_pfloat sr2 = 1.0f / rsq;
+        const MMD_pfloat sr6 = sr2 * sr2 * sr2 * sigma6;
+        const MMD_pfloat force = 48.0f * sr6 * (sr6 - 0.5f) * sr2 * epsilon;
+
+        fix += delx * force;
+        fiy += dely * force;
+        fiz += delz * force;
+
+        if(GHOST_NEWTON || j < nlocal) {
+          f[j * PAD + 0] -= delx * force;
+          f[j * PAD + 1] -= dely * force;
+          f[j * PAD + 2] -= delz * force;
+        }
+
+        if(EVFLAG) {
+          const MMD_float scale = (GHOST_NEWTON || j < nlocal) ? 1.0 : 0.5;
+          t_energy += scale * (4.0 * sr6 * (sr6 - 1.0)) * epsilon;
+          t_virial += scale * (delx * delx + dely * dely + delz * delz) * force;
+        }
+
+      }
+    }
+
+    f[i * PAD + 0] += fix;
+    f[i * PAD + 1] += fiy;
+    f[i * PAD + 2] += fiz;
+
+  }
+
+  force_lj->eng_vdwl += t_energy;
+  force_lj->virial += t_virial;
+
+}
+
+// the threaded half neighborlist kernel once per threading mode
+
+#define HALF_ATOMIC 0
+#include "force_lj_threaded.h"
+#undef HALF_ATOMIC
+#define HALF_ATOMIC 1
+#include "force_lj_threaded.h"
+#undef HALF_ATOMIC
+
+//optimised version of compute
+//  -MPI + OpenMP (half neighborlists)
+//  -threads work on the colored bin blocks of Neighbor_build_colors:
+//   blocks of one color never share an fj, so no atomics and no force copies
+//  -use temporary variable for summing up fi
+static void FORCELJ_KERNEL(ForceLJ_compute_halfneigh_colored)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
+  const int* const restrict firstneigh = neighbor->firstneigh;
+  const int nthreads = force_lj->threads->omp_num_threads;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  const int* const restrict neighbors = neighbor->neighbors;
+  const int* const restrict numneigh = neighbor->numneigh;
+  const int* const restrict block_start = neighbor->block_start;
+  const int* const restrict block_atoms = neighbor->block_atoms;
+  const MMD_pfloat sigma6 = force_lj->sigma6;
+  const MMD_pfloat epsilon = force_lj->epsilon;
+  const MMD_pfloat cutforcesq = force_lj->cutforcesq;
+
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+
+  #pragma omp parallel num_threads(nthreads) reduction(+:t_eng_vdwl,t_virial)
+  {
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nall * PAD; i++)
+      f[i] = 0.0;
+
+    // the implicit barrier of each omp for separates the colors
+
+    for(int c = 0; c < 8; c++) {
+      #pragma omp for schedule(dynamic,1)
+      for(int b = neighbor->color_start[c]; b < neighbor->color_start[c + 1]; b++) {
+        for(int ii = block_start[b]; ii < block_start[b + 1]; ii++) {
+          const int i = block_atoms[ii];
+          const int* const neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
+          const int numneighs = numneigh[i];
+          const MMD_float xtmp = x[i * PAD + 0];
+          const MMD_float ytmp = x[i * PAD + 1];
+          const MMD_float ztmp = x[i * PAD + 2];
+          MMD_float fix = 0.0;
+          MMD_float fiy = 0.0;
+          MMD_float fiz = 0.0;
+
+          for(int k = 0; k < numneighs; k++) {
+            const int j = neighs[k * stride];
+            const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+            const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+            const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+            const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+
+            if(rsq < cutforcesq) {
+              const MMD_pfloat sr2 = 1.0f / rsq;
+              const MMD_pfloat sr6 = sr2 * sr2 * sr2 * sigma6;
+              const MMD_pfloat force = 48.0f * sr6 * (sr6 - 0.5f) * sr2 * epsilon;
+
+              fix += delx * force;
+              fiy += dely * force;
+              fiz += delz * force;
+
+              if(GHOST_NEWTON || j < nlocal) {
+                f[j * PAD + 0] -= delx * force;
+                f[j * PAD + 1] -= dely * force;
+                f[j * PAD + 2] -= delz * force;
+              }
+
+              if(EVFLAG) {
+                const MMD_float scale = (GHOST_NEWTON || j < nlocal) ? 1.0 : 0.5;
+                t_eng_vdwl += scale * (4.0 * sr6 * (sr6 - 1.0)) * epsilon;
+                t_virial += scale * (delx * delx + dely * dely + delz * delz) * force;
+              }
+            }
+          }
+
+          f[i * PAD + 0] += fix;
+          f[i * PAD + 1] += fiy;
+          f[i * PAD + 2] += fiz;
+        }
+      }
+    }
+  }
+
+  force_lj->eng_vdwl += t_eng_vdwl;
+  force_lj->virial += t_virial;
+}
+
+#if !GHOST_NEWTON
+//optimised version of compute
+//  -MPI + OpenMP (using full neighborlists)
+//  -gets rid of fj update (read/write to memory)
+//  -use temporary variable for summing up fi
+//  -enables vectorization by:
+//    -get rid of 2d pointers
+//    -use pragma simd to force vectorization of inner loop
+static void FORCELJ_KERNEL_EV(ForceLJ_compute_fullneigh)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  //int tid = omp_get_thread_num();
+
+  const int nlocal = atom->nlocal;
+  const MMD_float* const restrict x = atom->d_x; //&atom.x[0][0];
+  //MMD_float* const restrict f = &atom.f[0][0];
+  MMD_float* const restrict f = atom->d_f;
+  const int* const restrict neighbors = neighbor->d_neighbors;
+  const int* const restrict numneigh = neighbor->d_numneigh;
+  const int* const restrict firstneigh = neighbor->d_firstneigh;
+  const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
+  const MMD_pfloat sigma6_ = force_lj->sigma6;
+  const MMD_pfloat epsilon_ = force_lj->epsilon;
+  const MMD_pfloat cutforcesq_ = force_lj->cutforcesq;
+
+  // clear force on own and ghost atoms
+
+  
+#pragma acc data deviceptr(x,neighbors,numneigh,firstneigh,f) //copyout(f[0:nall*3]) 
+{
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+  #pragma acc kernels
+  for(int i = 0; i < nlocal; i++) {
+    f[i * PAD + 0] = 0.0;
+    f[i * PAD + 1] = 0.0;
+    f[i * PAD + 2] = 0.0;
+  }
+
+  // loop over all neighbors of my atoms
+  // store force on atom i
+
+  // energy and virial are reduced on the device in the same kernel,
+  // on non EVFLAG steps the branch below is uniform and the sums stay zero
+
+  #pragma acc parallel loop reduction(+:t_eng_vdwl,t_virial)
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
+    const int numneighs = numneigh[i];
+    const MMD_float xtmp = x[i * PAD + 0];
+    const MMD_float ytmp = x[i * PAD + 1];
+    const MMD_float ztmp = x[i * PAD + 2];
+    MMD_float fix = 0;
+    MMD_float fiy = 0;
+    MMD_float fiz = 0;
+
+    //pragma simd forces vectorization (ignoring the performance objections of the compiler)
+    //also give hint to use certain vectorlength for MIC, Sandy Bridge and WESTMERE this should be be 8 here
+    //give hint to compiler that fix, fiy and fiz are used for reduction only
+
+    for(int k = 0; k < numneighs; k++) {
+      const int j = neighs[k*stride];
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+      if(rsq < cutforcesq_) {
+        const MMD_pfloat sr2 = 1.0f / rsq;
+        const MMD_pfloat sr6 = sr2 * sr2 * sr2 * sigma6_;
+        const MMD_pfloat force = 48.0f * sr6 * (sr6 - 0.5f) * sr2 * epsilon_;
+        fix += delx * force;
+        fiy += dely * force;
+        fiz += delz * force;
+        if(EVFLAG) {
+          t_eng_vdwl += sr6 * (sr6 - 1.0) * epsilon_;
+          t_virial += (delx * delx + dely * dely + delz * delz) * force;
+        }
+      }
+    }
+
+    f[i * PAD + 0] += fix;
+    f[i * PAD + 1] += fiy;
+    f[i * PAD + 2] += fiz;
+
+  }
+  t_eng_vdwl *= 4.0;
+  t_virial *= 0.5;
+  force_lj->eng_vdwl += t_eng_vdwl;
+  force_lj->virial += t_virial;
+}
+
+  
+  
+  
+}
+/* full neighborlist kernel over ilist[ifrom..ito) for the overlapped halo
+   exchange (ForceLJ_compute_overlap), forces are cleared by the caller */
+
+static void FORCELJ_KERNEL_EV(ForceLJ_compute_fullneigh_ilist)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int ifrom, int ito)
+{
+  const MMD_float* const restrict x = atom->d_x;
+  MMD_float* const restrict f = atom->d_f;
+  const int* const restrict ilist = neighbor->d_ilist;
+  const int* const restrict neighbors = neighbor->d_neighbors;
+  const int* const restrict numneigh = neighbor->d_numneigh;
+  const int* const restrict firstneigh = neighbor->d_firstneigh;
+  const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
+  const MMD_pfloat sigma6_ = force_lj->sigma6;
+  const MMD_pfloat epsilon_ = force_lj->epsilon;
+  const MMD_pfloat cutforcesq_ = force_lj->cutforcesq;
+
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+
+  #pragma acc parallel loop reduction(+:t_eng_vdwl,t_virial) deviceptr(x,f,ilist,neighbors,numneigh,firstneigh)
+  for(int ii = ifrom; ii < ito; ii++) {
+    const int i = ilist[ii];
+    const int* const neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
+    const int numneighs = numneigh[i];
+    const MMD_float xtmp = x[i * PAD + 0];
+    const MMD_float ytmp = x[i * PAD + 1];
+    const MMD_float ztmp = x[i * PAD + 2];
+    MMD_float fix = 0;
+    MMD_float fiy = 0;
+    MMD_float fiz = 0;
+
+    for(int k = 0; k < numneighs; k++) {
+      const int j = neighs[k*stride];
+      const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+      const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+      const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+      const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+      if(rsq < cutforcesq_) {
+        const MMD_pfloat sr2 = 1.0f / rsq;
+        const MMD_pfloat sr6 = sr2 * sr2 * sr2 * sigma6_;
+        const MMD_pfloat force = 48.0f * sr6 * (sr6 - 0.5f) * sr2 * epsilon_;
+        fix += delx * force;
+        fiy += dely * force;
+        fiz += delz * force;
+        if(EVFLAG) {
+          t_eng_vdwl += sr6 * (sr6 - 1.0) * epsilon_;
+          t_virial += (delx * delx + dely * dely + delz * delz) * force;
+        }
+      }
+    }
+
+    f[i * PAD + 0] += fix;
+    f[i * PAD + 1] += fiy;
+    f[i * PAD + 2] += fiz;
+  }
+
+  force_lj->eng_vdwl += 4.0 * t_eng_vdwl;
+  force_lj->virial += 0.5 * t_virial;
+}
+#endif
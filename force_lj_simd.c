@@ -0,0 +1,62 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "force_lj.h"
+#include "openmp.h"
+#include "simd.h"
+
+#ifdef HAVE_SIMD_KERNELS
+
+#define SIMD_ISA avx2
+#include "simd_isa.h"
+
+#define EVFLAG 0
+#include "force_lj_simd.h"
+#undef EVFLAG
+#define EVFLAG 1
+#include "force_lj_simd.h"
+#undef EVFLAG
+
+#undef SIMD_ISA
+#define SIMD_ISA avx512
+#include "simd_isa.h"
+
+#define EVFLAG 0
+#include "force_lj_simd.h"
+#undef EVFLAG
+#define EVFLAG 1
+#include "force_lj_simd.h"
+#undef EVFLAG
+
+#endif //HAVE_SIMD_KERNELS
@@ -0,0 +1,304 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+/* intrinsics LJ kernels, included by force_lj_simd.c once per ISA and EVFLAG
+   after simd_isa.h has set up the vector macros for SIMD_ISA
+   -host kernels on atom->x / atom->f with layout right neighborlists
+   -the lists are padded with i up to CHUNKSIZE, so the j loop runs in whole
+    vectors; the padding lanes have rsq == 0 and drop out of the cutoff mask
+   -x[j] is fetched with gathers on j*PAD, except in the cluster pair kernel */
+
+#define FORCELJ_SIMD_PASTE(name, isa, e) name##_##isa##_e##e
+#define FORCELJ_SIMD_NAME(name, isa, e) FORCELJ_SIMD_PASTE(name, isa, e)
+#define FORCELJ_SIMD_KERNEL(name) FORCELJ_SIMD_NAME(name, SIMD_ISA, EVFLAG)
+
+//full neighborlists
+//  -MPI + OpenMP, no write conflicts
+SIMD_TARGET
+void FORCELJ_SIMD_KERNEL(ForceLJ_compute_fullneigh)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  const int nlocal = atom->nlocal;
+  const int* const restrict firstneigh = neighbor->firstneigh;
+  const int nthreads = force_lj->threads->omp_num_threads;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  const int* const restrict neighbors = neighbor->neighbors;
+  const int* const restrict numneigh = neighbor->numneigh;
+  const MMD_float epsilon = force_lj->epsilon;
+
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:t_eng_vdwl,t_virial)
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[firstneigh[i]];
+    const int numneighs = (numneigh[i] + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    const vreal xtmp = V_SET1(x[i * PAD + 0]);
+    const vreal ytmp = V_SET1(x[i * PAD + 1]);
+    const vreal ztmp = V_SET1(x[i * PAD + 2]);
+    const vreal cutforcesq = V_SET1(force_lj->cutforcesq);
+    const vreal sigma6 = V_SET1(force_lj->sigma6);
+    const vreal c48eps = V_SET1(48.0 * epsilon);
+    const vreal half = V_SET1(0.5);
+    const vreal one = V_SET1(1.0);
+    vreal fix = V_ZERO();
+    vreal fiy = V_ZERO();
+    vreal fiz = V_ZERO();
+    vreal eng = V_ZERO();
+    vreal vir = V_ZERO();
+
+    for(int k = 0; k < numneighs; k += SIMD_WIDTH) {
+      const vindex j = I_MULC(I_LOAD(&neighs[k]), PAD);
+      const vreal delx = V_SUB(xtmp, V_GATHER(x + 0, j));
+      const vreal dely = V_SUB(ytmp, V_GATHER(x + 1, j));
+      const vreal delz = V_SUB(ztmp, V_GATHER(x + 2, j));
+      const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+      const vmask mask = M_CUTOFF(rsq, cutforcesq);
+
+      const vreal sr2 = V_DIV(one, rsq);
+      const vreal sr6 = V_MUL(V_MUL(sr2, V_MUL(sr2, sr2)), sigma6);
+      const vreal force = V_MASKZ(mask, V_MUL(V_MUL(c48eps, sr6), V_MUL(V_SUB(sr6, half), sr2)));
+
+      fix = V_FMA(delx, force, fix);
+      fiy = V_FMA(dely, force, fiy);
+      fiz = V_FMA(delz, force, fiz);
+
+      if(EVFLAG) {
+        eng = V_ADD(eng, V_MASKZ(mask, V_MUL(sr6, V_SUB(sr6, one))));
+        vir = V_FMA(rsq, force, vir);
+      }
+    }
+
+    f[i * PAD + 0] = V_HSUM(fix);
+    f[i * PAD + 1] = V_HSUM(fiy);
+    f[i * PAD + 2] = V_HSUM(fiz);
+
+    if(EVFLAG) {
+      t_eng_vdwl += V_HSUM(eng) * epsilon;
+      t_virial += V_HSUM(vir);
+    }
+  }
+
+  force_lj->eng_vdwl += 4.0 * t_eng_vdwl;
+  force_lj->virial += 0.5 * t_virial;
+}
+
+//cluster pair lists (Neighbor_build_clusters)
+//  -MPI + OpenMP over the local i-clusters, no write conflicts
+//  -CLUSTER_M x SIMD_WIDTH tiles: the i atoms are broadcast once per
+//   i-cluster, each j-cluster is three aligned vector loads (no gathers)
+SIMD_TARGET
+void FORCELJ_SIMD_KERNEL(ForceLJ_compute_cluster)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  const int nclusters = neighbor->nlocal_clusters;
+  const int maxneighs = neighbor->max_cluster_neighs;
+  const int nthreads = force_lj->threads->omp_num_threads;
+  const int cpj = SIMD_WIDTH / CLUSTER_M;
+  MMD_float* const restrict f = &atom->f[0][0];
+  const MMD_float* const restrict cx = neighbor->cluster_x;
+  const int* const restrict cluster_atoms = neighbor->cluster_atoms;
+  const int* const restrict cluster_neighbors = neighbor->cluster_neighbors;
+  const int* const restrict cluster_numneigh = neighbor->cluster_numneigh;
+  const MMD_float epsilon = force_lj->epsilon;
+
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+
+  Neighbor_update_clusters(neighbor, atom);
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:t_eng_vdwl,t_virial)
+  for(int ic = 0; ic < nclusters; ic++) {
+    const int* const neighs = &cluster_neighbors[ic * maxneighs];
+    const int numneighs = cluster_numneigh[ic];
+    const MMD_float* const xi = &cx[(ic / cpj) * 3 * SIMD_WIDTH + (ic % cpj) * CLUSTER_M];
+    const vreal cutforcesq = V_SET1(force_lj->cutforcesq);
+    const vreal sigma6 = V_SET1(force_lj->sigma6);
+    const vreal c48eps = V_SET1(48.0 * epsilon);
+    const vreal half = V_SET1(0.5);
+    const vreal one = V_SET1(1.0);
+    vreal xtmp[CLUSTER_M], ytmp[CLUSTER_M], ztmp[CLUSTER_M];
+    vreal fix[CLUSTER_M], fiy[CLUSTER_M], fiz[CLUSTER_M];
+    vreal eng = V_ZERO();
+    vreal vir = V_ZERO();
+
+    #pragma GCC unroll 4
+    for(int m = 0; m < CLUSTER_M; m++) {
+      xtmp[m] = V_SET1(xi[0 * SIMD_WIDTH + m]);
+      ytmp[m] = V_SET1(xi[1 * SIMD_WIDTH + m]);
+      ztmp[m] = V_SET1(xi[2 * SIMD_WIDTH + m]);
+      fix[m] = fiy[m] = fiz[m] = V_ZERO();
+    }
+
+    for(int k = 0; k < numneighs; k++) {
+      const MMD_float* const xj = &cx[neighs[k] * 3 * SIMD_WIDTH];
+      const vreal xjv = V_LOAD(xj + 0 * SIMD_WIDTH);
+      const vreal yjv = V_LOAD(xj + 1 * SIMD_WIDTH);
+      const vreal zjv = V_LOAD(xj + 2 * SIMD_WIDTH);
+
+      #pragma GCC unroll 4
+      for(int m = 0; m < CLUSTER_M; m++) {
+        const vreal delx = V_SUB(xtmp[m], xjv);
+        const vreal dely = V_SUB(ytmp[m], yjv);
+        const vreal delz = V_SUB(ztmp[m], zjv);
+        const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+        const vmask mask = M_CUTOFF(rsq, cutforcesq);
+
+        const vreal sr2 = V_DIV(one, rsq);
+        const vreal sr6 = V_MUL(V_MUL(sr2, V_MUL(sr2, sr2)), sigma6);
+        const vreal force = V_MASKZ(mask, V_MUL(V_MUL(c48eps, sr6), V_MUL(V_SUB(sr6, half), sr2)));
+
+        fix[m] = V_FMA(delx, force, fix[m]);
+        fiy[m] = V_FMA(dely, force, fiy[m]);
+        fiz[m] = V_FMA(delz, force, fiz[m]);
+
+        if(EVFLAG) {
+          eng = V_ADD(eng, V_MASKZ(mask, V_MUL(sr6, V_SUB(sr6, one))));
+          vir = V_FMA(rsq, force, vir);
+        }
+      }
+    }
+
+    for(int m = 0; m < CLUSTER_M; m++) {
+      const int i = cluster_atoms[ic * CLUSTER_M + m];
+
+      if(i < 0) continue;
+
+      f[i * PAD + 0] = V_HSUM(fix[m]);
+      f[i * PAD + 1] = V_HSUM(fiy[m]);
+      f[i * PAD + 2] = V_HSUM(fiz[m]);
+    }
+
+    if(EVFLAG) {
+      t_eng_vdwl += V_HSUM(eng) * epsilon;
+      t_virial += V_HSUM(vir);
+    }
+  }
+
+  force_lj->eng_vdwl += 4.0 * t_eng_vdwl;
+  force_lj->virial += 0.5 * t_virial;
+}
+
+//half neighborlists
+//  -MPI only (the threaded half neighborlist variants stay scalar)
+//  -fi and the pair forces are vectorized, the fj update is a scalar
+//   loop over the lanes since AVX2 has no scatter and j may be a ghost
+SIMD_TARGET
+void FORCELJ_SIMD_KERNEL(ForceLJ_compute_halfneigh)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+{
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const int* const restrict firstneigh = neighbor->firstneigh;
+  const int ghost_newton = neighbor->ghost_newton;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  const int* const restrict neighbors = neighbor->neighbors;
+  const int* const restrict numneigh = neighbor->numneigh;
+  const MMD_float epsilon = force_lj->epsilon;
+  const vreal cutforcesq = V_SET1(force_lj->cutforcesq);
+  const vreal sigma6 = V_SET1(force_lj->sigma6);
+  const vreal c48eps = V_SET1(48.0 * epsilon);
+  const vreal c4eps = V_SET1(4.0 * epsilon);
+  const vreal half = V_SET1(0.5);
+  const vreal one = V_SET1(1.0);
+
+  MMD_float tdelx[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tdely[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tdelz[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float tforce[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float teng[SIMD_WIDTH] __attribute__((aligned(64)));
+
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+
+  // clear force on own and ghost atoms
+
+  for(int i = 0; i < nall * PAD; i++)
+    f[i] = 0.0;
+
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[firstneigh[i]];
+    const int numneighs = (numneigh[i] + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    const vreal xtmp = V_SET1(x[i * PAD + 0]);
+    const vreal ytmp = V_SET1(x[i * PAD + 1]);
+    const vreal ztmp = V_SET1(x[i * PAD + 2]);
+    vreal fix = V_ZERO();
+    vreal fiy = V_ZERO();
+    vreal fiz = V_ZERO();
+
+    for(int k = 0; k < numneighs; k += SIMD_WIDTH) {
+      const vindex j = I_MULC(I_LOAD(&neighs[k]), PAD);
+      const vreal delx = V_SUB(xtmp, V_GATHER(x + 0, j));
+      const vreal dely = V_SUB(ytmp, V_GATHER(x + 1, j));
+      const vreal delz = V_SUB(ztmp, V_GATHER(x + 2, j));
+      const vreal rsq = V_FMA(delx, delx, V_FMA(dely, dely, V_MUL(delz, delz)));
+      const vmask mask = M_CUTOFF(rsq, cutforcesq);
+
+      const vreal sr2 = V_DIV(one, rsq);
+      const vreal sr6 = V_MUL(V_MUL(sr2, V_MUL(sr2, sr2)), sigma6);
+      const vreal force = V_MASKZ(mask, V_MUL(V_MUL(c48eps, sr6), V_MUL(V_SUB(sr6, half), sr2)));
+
+      fix = V_FMA(delx, force, fix);
+      fiy = V_FMA(dely, force, fiy);
+      fiz = V_FMA(delz, force, fiz);
+
+      V_STORE(tdelx, delx);
+      V_STORE(tdely, dely);
+      V_STORE(tdelz, delz);
+      V_STORE(tforce, force);
+
+      if(EVFLAG)
+        V_STORE(teng, V_MASKZ(mask, V_MUL(c4eps, V_MUL(sr6, V_SUB(sr6, one)))));
+
+      for(int l = 0; l < SIMD_WIDTH; l++) {
+        const int jl = neighs[k + l];
+
+        if(ghost_newton || jl < nlocal) {
+          f[jl * PAD + 0] -= tdelx[l] * tforce[l];
+          f[jl * PAD + 1] -= tdely[l] * tforce[l];
+          f[jl * PAD + 2] -= tdelz[l] * tforce[l];
+        }
+
+        if(EVFLAG) {
+          const MMD_float scale = (ghost_newton || jl < nlocal) ? 1.0 : 0.5;
+          t_eng_vdwl += scale * teng[l];
+          t_virial += scale * (tdelx[l] * tdelx[l] + tdely[l] * tdely[l] + tdelz[l] * tdelz[l]) * tforce[l];
+        }
+      }
+    }
+
+    f[i * PAD + 0] += V_HSUM(fix);
+    f[i * PAD + 1] += V_HSUM(fiy);
+    f[i * PAD + 2] += V_HSUM(fiz);
+  }
+
+  force_lj->eng_vdwl += t_eng_vdwl;
+  force_lj->virial += t_virial;
+}
@@ -0,0 +1,178 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+/* threaded half neighborlist kernel of ForceLJ, included by
+   force_lj_kernels.h once per HALF_ATOMIC: the fj update goes to OpenMP
+   atomics (HALFNEIGH_ATOMIC) or to thread private copies of f
+   (HALFNEIGH_PRIVATE), without a branch in the pair loop */
+
+//optimised version of compute
+//  -MPI + OpenMP (half neighborlists)
+//  -fj update either goes to a thread private copy of f which is reduced
+//   into f afterwards (HALFNEIGH_PRIVATE) or uses OpenMP atomics (HALFNEIGH_ATOMIC)
+//  -use temporary variable for summing up fi
+//  -enables vectorization by:
+//    -getting rid of 2d pointers
+//    -use pragma simd to force vectorization of inner loop (not with atomics)
+#if HALF_ATOMIC
+static void FORCELJ_KERNEL(ForceLJ_compute_halfneigh_atomic)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+#else
+static void FORCELJ_KERNEL(ForceLJ_compute_halfneigh_private)(ForceLJ *force_lj, Atom *atom, Neighbor *neighbor, int me)
+#endif
+{
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
+  const int* const restrict firstneigh = neighbor->firstneigh;
+  const int nthreads = force_lj->threads->omp_num_threads;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  MMD_float* const restrict f = &atom->f[0][0];
+  const int* const restrict neighbors = neighbor->neighbors;
+  const int* const restrict numneigh = neighbor->numneigh;
+  const MMD_pfloat sigma6 = force_lj->sigma6;
+  const MMD_pfloat epsilon = force_lj->epsilon;
+  const MMD_pfloat cutforcesq = force_lj->cutforcesq;
+
+#if !HALF_ATOMIC
+  ForceLJ_grow_fthread(force_lj, nthreads * nall * PAD);
+
+  MMD_float* const restrict f_thread = force_lj->f_thread;
+#endif
+
+  MMD_float t_eng_vdwl = 0;
+  MMD_float t_virial = 0;
+
+  #pragma omp parallel num_threads(nthreads) reduction(+:t_eng_vdwl,t_virial)
+  {
+#if HALF_ATOMIC
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nall * PAD; i++)
+      f[i] = 0.0;
+#else
+    const int tid = omp_get_thread_num();
+    const int nthr = omp_get_num_threads();
+
+    // each thread clears its own copy (first touch keeps it NUMA local)
+
+    MMD_float* const restrict fthr = &f_thread[tid * nall * PAD];
+
+    for(int i = 0; i < nall * PAD; i++)
+      fthr[i] = 0.0;
+#endif
+
+    #pragma omp barrier
+
+    // loop over all neighbors of my atoms
+    // store force on both atoms i and j
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nlocal; i++) {
+      const int* const neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
+      const int numneighs = numneigh[i];
+      const MMD_float xtmp = x[i * PAD + 0];
+      const MMD_float ytmp = x[i * PAD + 1];
+      const MMD_float ztmp = x[i * PAD + 2];
+      MMD_float fix = 0.0;
+      MMD_float fiy = 0.0;
+      MMD_float fiz = 0.0;
+
+      for(int k = 0; k < numneighs; k++) {
+        const int j = neighs[k * stride];
+        const MMD_pfloat delx = xtmp - x[j * PAD + 0];
+        const MMD_pfloat dely = ytmp - x[j * PAD + 1];
+        const MMD_pfloat delz = ztmp - x[j * PAD + 2];
+        const MMD_pfloat rsq = delx * delx + dely * dely + delz * delz;
+
+        if(rsq < cutforcesq) {
+          const MMD_pfloat sr2 = 1.0f / rsq;
+          const MMD_pfloat sr6 = sr2 * sr2 * sr2 * sigma6;
+          const MMD_pfloat force = 48.0f * sr6 * (sr6 - 0.5f) * sr2 * epsilon;
+
+          fix += delx * force;
+          fiy += dely * force;
+          fiz += delz * force;
+
+          if(GHOST_NEWTON || j < nlocal) {
+#if HALF_ATOMIC
+            #pragma omp atomic
+            f[j * PAD + 0] -= delx * force;
+            #pragma omp atomic
+            f[j * PAD + 1] -= dely * force;
+            #pragma omp atomic
+            f[j * PAD + 2] -= delz * force;
+#else
+            fthr[j * PAD + 0] -= delx * force;
+            fthr[j * PAD + 1] -= dely * force;
+            fthr[j * PAD + 2] -= delz * force;
+#endif
+          }
+
+          if(EVFLAG) {
+            const MMD_float scale = (GHOST_NEWTON || j < nlocal) ? 1.0 : 0.5;
+            t_eng_vdwl += scale * (4.0 * sr6 * (sr6 - 1.0)) * epsilon;
+            t_virial += scale * (delx * delx + dely * dely + delz * delz) * force;
+          }
+        }
+      }
+
+#if HALF_ATOMIC
+      #pragma omp atomic
+      f[i * PAD + 0] += fix;
+      #pragma omp atomic
+      f[i * PAD + 1] += fiy;
+      #pragma omp atomic
+      f[i * PAD + 2] += fiz;
+#else
+      fthr[i * PAD + 0] += fix;
+      fthr[i * PAD + 1] += fiy;
+      fthr[i * PAD + 2] += fiz;
+#endif
+    }
+
+#if !HALF_ATOMIC
+    // sum up the thread private copies, every thread reduces a slice of f
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nall * PAD; i++) {
+      MMD_float sum = 0.0;
+
+      for(int t = 0; t < nthr; t++)
+        sum += f_thread[t * nall * PAD + i];
+
+      f[i] = sum;
+    }
+#endif
+  }
+
+  force_lj->eng_vdwl += t_eng_vdwl;
+  force_lj->virial += t_virial;
+}
+
@@ -120,7 +120,7 @@ int input(In *in, char* filename)
     sscanf(line, "%d", &in.thermo_nstat);
     fclose(fp);
 #else
-#if PRECISION==2
+#if PRECISION==2 || PRECISION==3
       fgets(line, MAXLINE, fp);
       fgets(line, MAXLINE, fp);
       fgets(line, MAXLINE, fp);
@@ -37,10 +37,13 @@
 #include "math.h"
 #include "comm.h"
 #include "force.h"
+#include "force_lj.h"
+#include "force_eam.h"
 
 void Integrate_init(Integrate *ig)
 {
     ig->sort_every = 20;
+    ig->overlap_comm = 0;
 }
 //void Integrate_destroy(Integrate *ig)
 //{
@@ -85,11 +88,23 @@ void Integrate_finalIntegrate(Integrate *ig)
   }
 }
 
+/* the overlapped halo exchange has its own kernel only for LJ with full
+   device lists (ForceLJ_compute_overlap) */
+
+static int Integrate_overlap_supported(Force *force, Neighbor *neighbor)
+{
+  return force->style == FORCELJ && !neighbor->halfneigh && !neighbor->clusterlist &&
+         !neighbor->outer && !force->use_oldcompute && force->simd == SIMD_NONE;
+}
+
 void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
                     Comm *comm, Thermo *thermo, Timer *timer)
 {
   int i, n;
 
+  if(ig->overlap_comm && !Integrate_overlap_supported(force, neighbor))
+    ig->overlap_comm = 0;
+
   comm->timer = timer;
   timer->array[TIME_TEST] = 0.0;
 
@@ -105,6 +120,9 @@ void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
     Atom_sync_device(atom, atom->d_x, &atom->x[0][0], atom->nmax*3*sizeof(MMD_float));
     Atom_sync_device(atom, atom->d_v, &atom->v[0][0], atom->nmax*3*sizeof(MMD_float));
 
+    if(ig->overlap_comm)
+      Neighbor_split_interior(neighbor, atom);
+
     for(n = 0; n < ig->ntimes; n++) {
 
       //x = &atom.x[0][0];
@@ -113,7 +131,7 @@ void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
       ig->x = atom->d_x;
       ig->v = atom->d_v;
       ig->f = atom->d_f;
-      ig->xold = &atom->xold[0][0];
+      ig->xold = atom->d_xold;
       ig->nlocal = atom->nlocal;
         //atom.sync_host(&atom.x[0][0],atom.d_x,atom.nmax*3*sizeof(MMD_float));
 //for(int i = 0; i<nlocal;i++) printf("A %i %lf %lf %lf\n",i,atom.x[i][0],atom.x[i][1],atom.x[i][2]);
@@ -124,23 +142,99 @@ void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
       
       Timer_stamp(timer);
 
-      if((n + 1) % neighbor->every) {
+      // with the displacement check every is the check interval, with outer
+      // lists (incremental updates, background builds) reneighboring steps
+      // between full rebuilds only filter the outer list (update the lists near
+      // atoms that moved, take over the lists of the helper thread)
+
+      const int partial = neighbor->outer || neighbor->incremental || neighbor->async_build;
+      int reneigh = (n + 1) % neighbor->every == 0;
+      int inner = 0;
+
+      if(reneigh && partial && (n + 1) % neighbor->full_every) {
+        inner = 1;
+
+        // the outer list and the ghosts of the last full rebuild only cover
+        // the inner cutoff while no atom moved more than half the outer skin
+
+        if(neighbor->outer) inner = !Neighbor_check_distance(neighbor, atom);
+
+        // updates keep the ghosts of the last full rebuild, an atom that moved
+        // near a sub-domain boundary may belong in a ghost shell it was not sent to
+
+        if(neighbor->incremental) inner = !Neighbor_check_ghosts(neighbor, atom);
+
+        // the background lists are one interval old, see Neighbor_async_check
+
+        if(neighbor->async_build) inner = !Neighbor_async_check(neighbor, atom);
+
+        reneigh = !inner;
+      } else if(reneigh && neighbor->check == 1 && !Neighbor_check_distance(neighbor, atom)) {
+        reneigh = 0;
+        inner = partial;
+      }
+
+      // check = 2 always rebuilds and counts the builds that came too late
+
+      if(reneigh && neighbor->check == 2)
+        neighbor->ndanger += Neighbor_check_distance(neighbor, atom);
+
+      // steps with unchanged lists communicate during the force computation
+
+      const int overlap = ig->overlap_comm && !reneigh && !inner;
+
+      if(!reneigh) {
         //atom.sync_host(&atom.x[0][0],atom.d_x,atom.nmax*3*sizeof(MMD_float));
 
-        Comm_communicate(comm, atom);
-        //atom.sync_device(atom.d_x,&atom.x[0][0],atom.nmax*3*sizeof(MMD_float));
+        if(!overlap) {
+          Comm_communicate(comm, atom);
+          //atom.sync_device(atom.d_x,&atom.x[0][0],atom.nmax*3*sizeof(MMD_float));
         
-        Timer_stamp_int(timer, TIME_COMM);
+          Timer_stamp_int(timer, TIME_COMM);
+        }
+
+        if(inner) {
+          if(neighbor->outer)
+            Neighbor_build_inner(neighbor, atom);
+          else if(neighbor->incremental)
+            Neighbor_update(neighbor, atom);
+          else
+            Neighbor_async_finish(neighbor, atom, 1);
+
+          if(ig->overlap_comm)
+            Neighbor_split_interior(neighbor, atom);
+
+          // the lists for the next reneighboring step, unless that one is a full rebuild
+
+          if(neighbor->async_build && (n + 1 + neighbor->every) % neighbor->full_every)
+            Neighbor_async_start(neighbor, atom);
 
+          Timer_stamp_int(timer, TIME_NEIGH);
+        }
       } else {
         Atom_sync_host(atom, (void *) &atom->x[0][0], (void *)atom->d_x, atom->nmax*3*sizeof(MMD_float));
         Atom_sync_host(atom, (void *) &atom->v[0][0], (void *)atom->d_v, atom->nmax*3*sizeof(MMD_float));
         {
 
           Timer_stamp_extra_start(timer);
+
+          // cutneigh covers the measured displacement of the background lists
+
+          if(neighbor->async_build && Neighbor_async_resize(neighbor, atom)) {
+            Comm_setup(comm, neighbor->cutneigh, atom);
+            Neighbor_setup(neighbor, atom);
+          }
+
           Comm_exchange(comm, atom);
+
+          // reorder the local atoms (Morton order of their bins), timed on its own
+
           if(n+1>=next_sort) {
-            //atom.sort(neighbor);
+            Timer_stamp_extra_stop(timer, TIME_TEST);
+            Timer_stamp_int(timer, TIME_COMM);
+            Atom_sort(atom, neighbor);
+            Timer_stamp_int(timer, TIME_SORT);
+            Timer_stamp_extra_start(timer);
             next_sort +=  ig->sort_every;
           }
           Comm_borders(comm, atom);
@@ -150,20 +244,33 @@ void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
             Timer_stamp_int(timer, TIME_COMM);
           }
 
+          if(comm->ghost_sort) {
+            Comm_sort_ghosts(comm, atom, neighbor);
+            Timer_stamp_int(timer, TIME_SORT);
+          }
+
         }
 
         Neighbor_build(neighbor, atom);
 
+        if(ig->overlap_comm)
+          Neighbor_split_interior(neighbor, atom);
+
+        if(neighbor->async_build && (n + 1 + neighbor->every) % neighbor->full_every)
+          Neighbor_async_start(neighbor, atom);
+
         //atom.sync_device(atom.d_x,&atom.x[0][0],atom.nmax*3*sizeof(MMD_float));
         Atom_sync_device(atom, atom->d_v, &atom->v[0][0], atom->nmax*3*sizeof(MMD_float));
         Timer_stamp_int(timer, TIME_NEIGH);
       }
       Timer_stamp_int(timer, TIME_TEST);
       force->evflag = (n + 1) % thermo->nstat == 0;
-      if(force->style == FORCELJ) {
+      if(overlap) {
+        ForceLJ_compute_overlap(force, atom, neighbor, comm, comm->me);
+      } else if(force->style == FORCELJ) {
         ForceLJ_compute(force, atom, neighbor, comm, comm->me);
       } else if(force->style == FORCEEAM) {
-        ForceEAM_compute(force, atom, neighbor, comm, comm->me);
+        ForceEAM_compute((ForceEAM *) force, atom, neighbor, comm, comm->me);
       } else{
         assert(0);
       }
@@ -175,6 +282,7 @@ void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
       if(neighbor->halfneigh && neighbor->ghost_newton) {
         Atom_sync_host(atom, &atom->f[0][0], atom->d_f, atom->nmax*3*sizeof(MMD_float));
         Comm_reverse_communicate(comm, atom);
+        Atom_sync_device(atom, atom->d_f, &atom->f[0][0], atom->nmax*3*sizeof(MMD_float));
 
         
         Timer_stamp_int(timer, TIME_COMM);
@@ -197,6 +305,10 @@ void Integrate_run(Integrate *ig, Atom *atom, Force *force, Neighbor *neighbor,
         Thermo_compute(thermo, n + 1, atom, neighbor, force, timer, comm);
       }
     }
+
+    // drop a background build for a step beyond the end of the run
+
+    Neighbor_async_finish(neighbor, atom, 0);
   } //end OpenMP parallel
         Atom_sync_host(atom, &atom->v[0][0], atom->d_v, atom->nmax*3*sizeof(MMD_float));
         Atom_sync_host(atom, &atom->x[0][0], atom->d_x, atom->nmax*3*sizeof(MMD_float));
@@ -47,6 +47,7 @@ typedef struct Integrate_s
     MMD_float mass;
 
     MMD_int sort_every;
+    int overlap_comm;                 // 1: halo exchange in flight during the interior forces
 
 
     ThreadData* threads;
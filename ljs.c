@@ -48,7 +48,9 @@
 #include "force_eam.h"
 #include "force.h"
 #include "force_lj.h"
+#include "simd.h"
 #include "openacc.h"
+#include "math.h"
 
 #define MAXLINE 256
 
@@ -58,12 +60,15 @@ int create_atoms(Atom *, int, int, int, double);
 void create_velocity(double, Atom *, Thermo *);
 void output(In *, Atom *, Force*, Neighbor *, Comm *,
             Thermo *, Integrate *, Timer *, int);
+void autotune(In *, Atom *, Force*, Neighbor *, Comm *,
+              Thermo *, Integrate *, Timer *, int);
 int read_lammps_data(Atom *atom, Comm *comm, Neighbor *neighbor, Integrate *integrate, Thermo *thermo, char* file, int units);
 
 int main(int argc, char** argv)
 {
   In in;
   in.datafile = NULL;
+  in.autotune = 0;
   int me = 0;                   //local MPI rank
   int nprocs = 1;               //number of MPI ranks
   int num_threads = 1;		//number of OpenMP threads
@@ -83,7 +88,19 @@ int main(int argc, char** argv)
   int neighbor_size = -1;
   char* input_file = NULL;
   int ghost_newton = 1;
+  int half_threading = HALFNEIGH_PRIVATE; //threading strategy of the half neighborlist force
+  int cluster = 0;              //1: cluster pair lists for the intrinsics kernels
+  int neigh_check = 0;          //1: displacement check before reneighboring
+  double outer_skin = 0.0;      //>0: extra skin of an outer neighbor list
+  int full_every = 0;           //full rebuild frequency with outer lists or incremental updates
+  int incremental = 0;          //1: incremental neighbor list updates between full rebuilds
+  int async_neigh = 0;          //1: neighbor lists between full rebuilds built on a helper thread
+  int neigh_engine = NEIGH_BINS; //neighbor list builder: binned stencil sweep or sorted Morton keys
+  int autotune_steps = 0;       //>0: auto-tune skin, reneighbor interval and bins with trials of this many steps
   int sort = -1;
+  int ghost_sort = 0;           //1: reorder the ghost atoms by bin after every borders
+  int halo_direct = 0;          //1: halo swaps with all neighbor boxes at once instead of 3 dimension sweeps
+  int overlap_comm = 0;         //1: overlap the halo exchange with the forces of interior atoms
   int skip_gpu = 99999999;
   int ngpu = 2;
 
@@ -202,10 +219,57 @@ int main(int argc, char** argv)
     }
 
     if((strcmp(argv[i], "--half_neigh") == 0))  {
+      halfneigh = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "-ht") == 0) || (strcmp(argv[i], "--half_threading") == 0))  {
       ++i;
-      if(atoi(argv[i])!=0)
-      printf("WARNING: The OpenACC variant can only be run with --half_neigh 0! Ignoring user request.\n");
-      //halfneigh = atoi(argv[++i]);
+      if(strcmp(argv[i], "atomic") == 0) half_threading = HALFNEIGH_ATOMIC;
+      else if(strcmp(argv[i], "color") == 0) half_threading = HALFNEIGH_COLOR;
+      else half_threading = HALFNEIGH_PRIVATE;
+      continue;
+    }
+
+    if((strcmp(argv[i], "--cluster") == 0))  {
+      cluster = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--neigh_check") == 0))  {
+      neigh_check = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--outer_skin") == 0))  {
+      outer_skin = atof(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--incremental") == 0))  {
+      incremental = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--async_neigh") == 0))  {
+      async_neigh = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--neigh_engine") == 0))  {
+      ++i;
+      if(strcmp(argv[i], "morton") == 0) neigh_engine = NEIGH_MORTON;
+      else neigh_engine = NEIGH_BINS;
+      continue;
+    }
+
+    if((strcmp(argv[i], "--autotune") == 0))  {
+      autotune_steps = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--full_every") == 0))  {
+      full_every = atoi(argv[++i]);
       continue;
     }
 
@@ -219,11 +283,32 @@ int main(int argc, char** argv)
       continue;
     }
 
+    if((strcmp(argv[i], "--safe_exchange") == 0))  {
+      do_safeexchange = 1;
+      continue;
+    }
+
     if((strcmp(argv[i], "--sort") == 0))  {
       sort = atoi(argv[++i]);
       continue;
     }
 
+    if((strcmp(argv[i], "--ghost_sort") == 0))  {
+      ghost_sort = atoi(argv[++i]);
+      continue;
+    }
+
+    if((strcmp(argv[i], "--halo") == 0))  {
+      ++i;
+      halo_direct = strcmp(argv[i], "direct") == 0;
+      continue;
+    }
+
+    if((strcmp(argv[i], "--overlap_comm") == 0))  {
+      overlap_comm = atoi(argv[++i]);
+      continue;
+    }
+
     if((strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "--yaml_output") == 0))  {
       yaml_output = atoi(argv[++i]);
       continue;
@@ -276,13 +361,20 @@ int main(int argc, char** argv)
              "\t                                0: full neighborlist\n"
              "\t                                1: half neighborlist\n"
              "\t                               -1: original miniMD half neighborlist force (not OpenMP safe)\n");
+      printf("\t                                (half neighborlists run on the host with OpenMP threads)\n");
+      printf("\t-ht / --half_threading <string>: how threads update f[j] with half neighborlists\n"
+             "\t                                private: thread private force arrays + reduction (default)\n"
+             "\t                                atomic:  OpenMP atomics\n"
+             "\t                                color:   lock free over 8-colored blocks of neighbor bins\n");
       printf("\t-d / --device <int>:          choose device to use (only applicable for GPU execution)\n");
       printf("\t-dm / --device_map:           map devices to MPI ranks\n");
       printf("\t-ng / --num_gpus <int>:       give number of GPUs per Node (used in conjuction with -dm\n"
              "\t                              to determine device id: 'id=mpi_rank%%ng' (default 2)\n");
       printf("\t--skip_gpu <int>:             skip the specified gpu when assigning devices to MPI ranks\n"
              "\t                              used in conjunction with -dm (but must come first in arg list)\n");
-      printf("\t-sse <sse_version>:           use explicit sse intrinsics (use miniMD-SSE variant)\n");
+      printf("\t-sse <sse_version>:           use explicit intrinsics kernels: 1 = best of the CPU, 2 = AVX2, 3 = AVX-512\n");
+      printf("\t--cluster <int>:              1: cluster pair lists, 4 x SIMD width tiles for the intrinsics\n"
+             "\t                                kernels (needs -sse and full neighborlists, default 0)\n");
       printf("\t-gn / --ghost_newton <int>:   set usage of newtons third law for ghost atoms\n"
              "\t                                (only applicable with half neighborlists)\n");
       printf("\n  Simulation setup:\n");
@@ -291,6 +383,27 @@ int main(int argc, char** argv)
       printf("\t-s / --size <int>:            set linear dimension of systembox\n");
       printf("\t-nx/-ny/-nz <int>:            set linear dimension of systembox in x/y/z direction\n");
       printf("\t-b / --neigh_bins <int>:      set linear dimension of neighbor bin grid\n");
+      printf("\t--neigh_check <int>:          1: at every reneighboring step only rebuild if some atom moved\n"
+             "\t                                more than half the skin (default 0)\n");
+      printf("\t--outer_skin <float>:         >0: build an outer list with this extra skin from the bins and\n"
+             "\t                                filter the force lists from it at the reneighboring steps\n"
+             "\t                                in between, rebuilt early once an atom moved more than half\n"
+             "\t                                the extra skin (default 0, not with --cluster)\n");
+      printf("\t--incremental <int>:          1: at the reneighboring steps between full rebuilds only rebuild\n"
+             "\t                                the lists near atoms that changed bin (default 0, not with\n"
+             "\t                                --outer_skin, --cluster or ghost newton half neighborlists)\n");
+      printf("\t--async_neigh <int>:          1: build the lists of the reneighboring steps between full rebuilds\n"
+             "\t                                on a helper thread from the positions one interval earlier,\n"
+             "\t                                with an extra skin of twice the largest displacement over an\n"
+             "\t                                interval (default 0, host only, leave a core free)\n");
+      printf("\t--full_every <int>:           full rebuild (exchange, bins, outer list) every <n> steps with\n"
+             "\t                                --outer_skin or --incremental (default 5 x neigh frequency)\n");
+      printf("\t--neigh_engine <string>:      list builder: bins (binned stencil sweep, default) or morton\n"
+             "\t                                (atoms sorted by the Morton key of their cell, host build,\n"
+             "\t                                not with --cluster; updates and background builds use bins)\n");
+      printf("\t--autotune <int>:             >0: pick skin, neighbor frequency and bin size from short trial runs\n"
+             "\t                                of <int> steps at startup (default 0, not with --outer_skin,\n"
+             "\t                                --incremental or --async_neigh)\n");
       printf("\t-u / --units <string>:        set units (lj or metal), see LAMMPS documentation\n");
       printf("\t-p / --force <string>:        set interaction model (lj or eam)\n");
       printf("\t-f / --data_file <string>:    read configuration from LAMMPS data file\n");
@@ -299,7 +412,12 @@ int main(int argc, char** argv)
       printf("\t--check_exchange:             check whether atoms moved further than subdomain width\n");
       printf("\t--safe_exchange:              perform exchange communication with all MPI processes\n"
              "\t                                within rcut_neighbor (outer force cutoff)\n");
-      printf("\t--sort <n>:                   resort atoms (simple bins) every <n> steps (default: use reneigh frequency; never=0)");
+      printf("\t--sort <n>:                   resort atoms (Morton order of their bins) every <n> steps (default: use reneigh frequency; never=0)\n");
+      printf("\t--ghost_sort <int>:           1: reorder the ghost atoms by bin after every border exchange (default 0)\n");
+      printf("\t--halo <string>:              halo exchange: sweep (3 dimensions one after the other, default) or\n"
+             "\t                                direct (one message per neighbor box, all in flight at once)\n");
+      printf("\t--overlap_comm <int>:         1: compute the forces of atoms without ghost neighbors while the\n"
+             "\t                                halo exchange is in flight (LJ full neighborlists; default 0)\n");
       printf("\t-o / --yaml_output <int>:     level of yaml output (default 1)\n");
       printf("\t--yaml_screen:                write yaml output also to screen\n");
       printf("\t-h / --help:                  display this help message\n\n");
@@ -372,20 +490,29 @@ int main(int argc, char** argv)
   force->timer = &timer;
   comm.check_safeexchange = check_safeexchange;
   comm.do_safeexchange = do_safeexchange;
+  comm.ghost_sort = ghost_sort > 0;
+  comm.direct = halo_direct;
   force->use_sse = use_sse;
+  force->half_threading = half_threading;
   neighbor.halfneigh = halfneigh;
+  neighbor.bincolor = halfneigh > 0 && num_threads > 1 && half_threading == HALFNEIGH_COLOR;
+  neighbor.engine = neigh_engine;
 
   if(halfneigh < 0) force->use_oldcompute = 1;
 
-  if(use_sse) {
-#ifdef VARIANT_REFERENCE
+  // intrinsics kernels are picked from CPUID, they need host copies of the lists
 
-    if(me == 0) printf("ERROR: Trying to run with -sse with miniMD reference version. Use SSE variant instead. Exiting.\n");
+  force->simd = Simd_select(use_sse);
+  neighbor.hostlist = force->simd != SIMD_NONE;
 
-    MPI_Finalize();
-    exit(0);
-#endif
-  }
+  if(use_sse && force->simd == SIMD_NONE && me == 0)
+    printf("# No intrinsics kernel available for -sse %i on this CPU/build; using the default kernels.\n", use_sse);
+
+  neighbor.clusterlist = cluster > 0 && force->simd != SIMD_NONE && halfneigh == 0;
+  neighbor.cluster_n = neighbor.clusterlist ? Simd_width(force->simd) : CLUSTER_M;
+
+  if(cluster > 0 && !neighbor.clusterlist && me == 0)
+    printf("# Cluster pair lists need an intrinsics kernel (-sse) and full neighborlists; using atom lists.\n");
 
   if(num_steps > 0) in.ntimes = num_steps;
 
@@ -435,6 +562,38 @@ int main(int argc, char** argv)
   integrate.sort_every = sort>0?sort:(sort<0?in.neigh_every:0);
   neighbor.every = in.neigh_every;
   neighbor.cutneigh = in.neigh_cut;
+
+  // the bins, stencil and ghost shell cover the outer cutoff
+
+  if(outer_skin > 0.0 && !neighbor.clusterlist) {
+    neighbor.outer = 1;
+    neighbor.cutinner = in.neigh_cut;
+    neighbor.cutneigh = in.neigh_cut + outer_skin;
+    neighbor.full_every = full_every > 0 ? (full_every + neighbor.every - 1) / neighbor.every * neighbor.every : 5 * neighbor.every;
+  }
+
+  if(incremental > 0 && !neighbor.outer && !neighbor.clusterlist && !(neighbor.halfneigh && neighbor.ghost_newton)) {
+    neighbor.incremental = 1;
+    neighbor.full_every = full_every > 0 ? (full_every + neighbor.every - 1) / neighbor.every * neighbor.every : 5 * neighbor.every;
+  } else if(incremental > 0 && me == 0)
+    printf("# Incremental neighbor list updates not available with this configuration\n");
+
+  // the extra skin of the background lists is measured during the run
+
+  if(async_neigh > 0 && !neighbor.outer && !neighbor.incremental && !neighbor.clusterlist && !neigh_check &&
+     acc_get_device_type() == acc_device_host) {
+    neighbor.async_build = 1;
+    neighbor.full_every = full_every > 0 ? (full_every + neighbor.every - 1) / neighbor.every * neighbor.every : 5 * neighbor.every;
+  } else if(async_neigh > 0 && me == 0)
+    printf("# Background neighbor builds not available with this configuration\n");
+
+  // the split step has its own kernel, the one of the full neighborlists on the device
+
+  if(overlap_comm > 0 && in.forcetype == FORCELJ && !neighbor.halfneigh && !neighbor.clusterlist &&
+     !neighbor.outer && !force->use_oldcompute && force->simd == SIMD_NONE)
+    integrate.overlap_comm = 1;
+  else if(overlap_comm > 0 && me == 0)
+    printf("# Overlapped halo exchange not available with this configuration\n");
   force->cutforce = in.force_cut;
   thermo.nstat = in.thermo_nstat;
 
@@ -447,9 +606,9 @@ int main(int argc, char** argv)
     MMD_float volume = atom.box.xprd * atom.box.yprd * atom.box.zprd;
     in.rho = 1.0 * atom.natoms / volume;
     if(in.forcetype == FORCELJ) {
-      ForceLJ_setup((ForceLJ *) force, &atom);
+      ForceLJ_setup((ForceLJ *) force, &atom, &neighbor);
     } else if (in.forcetype == FORCEEAM) {
-      ForceEAM_setup((ForceEAM *) force, &atom);
+      ForceEAM_setup((ForceEAM *) force, &atom, &neighbor);
       atom.mass = force->mass;
     } else {
       assert(0);
@@ -464,9 +623,9 @@ int main(int argc, char** argv)
     Integrate_setup(&integrate);
 
     if(in.forcetype == FORCELJ) {
-      ForceLJ_setup((ForceLJ *) force, &atom);
+      ForceLJ_setup((ForceLJ *) force, &atom, &neighbor);
     } else if (in.forcetype == FORCEEAM) {
-      ForceEAM_setup((ForceEAM *) force, &atom);
+      ForceEAM_setup((ForceEAM *) force, &atom, &neighbor);
       atom.mass = force->mass;
     } else {
       assert(0);
@@ -479,6 +638,17 @@ int main(int argc, char** argv)
 
   }
 
+  // skin against the actual force cutoff (EAM takes it from the potential file)
+
+  neighbor.check = neigh_check;
+  neighbor.skin = neighbor.cutneigh - sqrt(force->cutforcesq);
+
+  if(autotune_steps > 0 && !neighbor.outer && !neighbor.incremental && !neighbor.async_build) {
+    in.autotune = autotune_steps;
+    autotune(&in, &atom, force, &neighbor, &comm, &thermo, &integrate, &timer, autotune_steps);
+  } else if(autotune_steps > 0 && me == 0)
+    printf("# Autotuning not available with this configuration\n");
+
   if(me == 0)
     printf("# Done .... \n");
 
@@ -501,20 +671,45 @@ int main(int argc, char** argv)
     fprintf(stdout, "# Technical Settings: \n");
     fprintf(stdout, "\t# Neigh cutoff: %lf\n", neighbor.cutneigh);
     fprintf(stdout, "\t# Half neighborlists: %i\n", neighbor.halfneigh);
+    fprintf(stdout, "\t# Half neighborlist threading: %s\n", force->half_threading == HALFNEIGH_ATOMIC ? "atomic" : (force->half_threading == HALFNEIGH_COLOR ? "color" : "private"));
     fprintf(stdout, "\t# Neighbor bins: %i %i %i\n", neighbor.nbinx, neighbor.nbiny, neighbor.nbinz);
     fprintf(stdout, "\t# Neighbor frequency: %i\n", neighbor.every);
+    fprintf(stdout, "\t# Neighbor engine: %s\n", neighbor.engine == NEIGH_MORTON && !neighbor.clusterlist ? "morton" : "bins");
+    fprintf(stdout, "\t# Neighbor check: %i (skin %lf)\n", neighbor.check, neighbor.skin);
+    fprintf(stdout, "\t# Autotune: %i\n", in.autotune);
+    if(neighbor.outer)
+      fprintf(stdout, "\t# Outer neighbor list: 1 (cutoff %lf, inner cutoff %lf, every %i)\n", neighbor.cutneigh, neighbor.cutinner, neighbor.full_every);
+    else
+      fprintf(stdout, "\t# Outer neighbor list: 0\n");
+    if(neighbor.incremental)
+      fprintf(stdout, "\t# Incremental neighbor updates: 1 (full rebuild every %i)\n", neighbor.full_every);
+    else
+      fprintf(stdout, "\t# Incremental neighbor updates: 0\n");
+    if(neighbor.async_build)
+      fprintf(stdout, "\t# Background neighbor builds: 1 (full rebuild every %i)\n", neighbor.full_every);
+    else
+      fprintf(stdout, "\t# Background neighbor builds: 0\n");
     fprintf(stdout, "\t# Sorting frequency: %i\n", integrate.sort_every);
+    fprintf(stdout, "\t# Ghost sorting: %i\n", comm.ghost_sort);
+    fprintf(stdout, "\t# Halo exchange: %s (%i swaps)\n", comm.direct ? "direct" : "sweep", comm.nswap);
+    fprintf(stdout, "\t# Overlapped halo exchange: %i\n", integrate.overlap_comm);
     fprintf(stdout, "\t# Thermo frequency: %i\n", thermo.nstat);
     fprintf(stdout, "\t# Ghost Newton: %i\n", ghost_newton);
-    fprintf(stdout, "\t# Use intrinsics: %i\n", force->use_sse);
+    fprintf(stdout, "\t# Use intrinsics: %i (%s)\n", force->use_sse, Simd_name(force->simd));
+    if(neighbor.clusterlist)
+      fprintf(stdout, "\t# Cluster pair lists: 1 (%i x %i tiles)\n", CLUSTER_M, neighbor.cluster_n);
+    else
+      fprintf(stdout, "\t# Cluster pair lists: 0\n");
     fprintf(stdout, "\t# Do safe exchange: %i\n", comm.do_safeexchange);
-    fprintf(stdout, "\t# Size of float: %i\n\n", sizeof(MMD_float));
+    fprintf(stdout, "\t# Size of float: %i (pair math: %i)\n\n", sizeof(MMD_float), (int) sizeof(MMD_pfloat));
   }
 
   Comm_exchange(&comm, &atom);
-  //if(sort>0)
-    //atom.sort(neighbor);
+  if(integrate.sort_every > 0)
+    Atom_sort(&atom, &neighbor);
   Comm_borders(&comm, &atom);
+  if(comm.ghost_sort)
+    Comm_sort_ghosts(&comm, &atom, &neighbor);
 
   force->evflag = 1;
   
@@ -534,8 +729,10 @@ int main(int argc, char** argv)
     //atom.sync_host(&atom.f[0][0],atom.d_f,atom.nmax*3*sizeof(MMD_float));
   }
   
-  if(neighbor.halfneigh && neighbor.ghost_newton)
+  if(neighbor.halfneigh && neighbor.ghost_newton) {
     Comm_reverse_communicate(&comm, &atom);
+    Atom_sync_device(&atom, atom.d_f, &atom.f[0][0], atom.nmax*PAD*sizeof(MMD_float));
+  }
 
   if(me == 0) printf("# Starting dynamics ...\n");
 
@@ -568,15 +765,24 @@ int main(int argc, char** argv)
   Thermo_compute(&thermo, -1, &atom, &neighbor, force, &timer, &comm);
 
   if(me == 0) {
-    double time_other = timer.array[TIME_TOTAL] - timer.array[TIME_FORCE] - timer.array[TIME_NEIGH] - timer.array[TIME_COMM];
+    double time_other = timer.array[TIME_TOTAL] - timer.array[TIME_FORCE] - timer.array[TIME_NEIGH] - timer.array[TIME_COMM] - timer.array[TIME_SORT];
     printf("\n\n");
     printf("# Performance Summary:\n");
-    printf("# MPI_proc OMP_threads nsteps natoms t_total t_force t_neigh t_comm t_other performance perf/thread grep_string t_extra\n");
-    printf("%i %i %i %i %lf %lf %lf %lf %lf %lf %lf PERF_SUMMARY %lf\n\n\n",
+    printf("# MPI_proc OMP_threads nsteps natoms t_total t_force t_neigh t_comm t_other performance perf/thread grep_string t_extra t_sort\n");
+    printf("%i %i %i %i %lf %lf %lf %lf %lf %lf %lf PERF_SUMMARY %lf %lf\n\n\n",
            nprocs, num_threads, integrate.ntimes, natoms,
            timer.array[TIME_TOTAL], timer.array[TIME_FORCE], timer.array[TIME_NEIGH], timer.array[TIME_COMM], time_other,
-           1.0 * natoms * integrate.ntimes / timer.array[TIME_TOTAL], 1.0 * natoms * integrate.ntimes / timer.array[TIME_TOTAL] / nprocs / num_threads, timer.array[TIME_TEST]);
+           1.0 * natoms * integrate.ntimes / timer.array[TIME_TOTAL], 1.0 * natoms * integrate.ntimes / timer.array[TIME_TOTAL] / nprocs / num_threads, timer.array[TIME_TEST], timer.array[TIME_SORT]);
+
+    if(neighbor.incremental)
+      printf("# Neighbor lists rebuilt by incremental updates: %i (%i local atoms)\n\n", neighbor.nupdated, atom.nlocal);
+
+    if(neighbor.async_build)
+      printf("# Neighbor lists built in the background: %i of %i (%i dropped, extra skin %lf)\n\n",
+             neighbor.nasync, neighbor.ncalls, neighbor.ndropped, neighbor.async_skin);
 
+    if(neighbor.check || neighbor.outer)
+      printf("# Neighbor builds: %i (%i checks without rebuild)\n\n", neighbor.ncalls, neighbor.nskip);
   }
 
   if(yaml_output)
@@ -48,6 +48,7 @@ typedef struct{
   MMD_float force_cut;
   MMD_float neigh_cut;
   int thermo_nstat;
+  int autotune;                 // steps per trial of the startup auto-tuner (0: off)
 }In;
 
 #endif
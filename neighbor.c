@@ -31,302 +31,1852 @@
 
 #include "stdio.h"
 #include "stdlib.h"
+#include "math.h"
 
 #include "neighbor.h"
 #include "openmp.h"
 #include "openacc.h"
+#include "mpi.h"
+#include <pthread.h>
+
+/* background builds: the helper thread bins and sweeps a position snapshot
+   into a shadow Neighbor (own lists and bins, configuration of the main one)
+   with a single OpenMP thread */
+
+typedef struct NeighborAsync_s
+{
+    pthread_t thread;
+    int running;                     // helper thread launched and not joined yet
+    int ready;                       // a build was started and not taken over yet
+    Neighbor shadow;
+    Atom atom;                       // nlocal, nghost, box and the snapshot as x / d_x
+    MMD_float* xsnap;
+    int max_snap;
+    int mbins;                       // size of the bin arrays of the shadow
+    int device;
+    ThreadData threads;
+} NeighborAsync;
 #define FACTOR 0.999
 #define SMALL 1.0e-6
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define BIG 1.0e30
+#define ASYNC_MARGIN 1.1           // extra skin of the background lists over twice the measured displacement
+
+void Neighbor_init(Neighbor *n)
+{
+  n->ncalls = 0;
+  n->check = 0;
+  n->skin = 0.0;
+  n->nskip = 0;
+  n->ndanger = 0;
+  n->outer = 0;
+  n->full_every = 0;
+  n->cutinner = n->cutinnersq = 0.0;
+  n->outer_numneigh = n->d_outer_numneigh = NULL;
+  n->outer_firstneigh = n->d_outer_firstneigh = NULL;
+  n->outer_neighbors = n->d_outer_neighbors = NULL;
+  n->outer_totalneigh = n->outer_maxneighs = n->max_outer_totalneigh = 0;
+  n->incremental = 0;
+  n->nupdated = 0;
+  n->rebuild = n->d_rebuild = NULL;
+  n->buildbin = n->dirtybin = NULL;
+  n->prev_firstneigh = n->d_prev_firstneigh = NULL;
+  n->prev_neighbors = n->d_prev_neighbors = NULL;
+  n->max_prev_totalneigh = 0;
+  n->async_build = 0;
+  n->nasync = 0;
+  n->async_skin = 0.0;
+  n->async_disp = 0.0;
+  n->ndropped = 0;
+  n->async = NULL;
+  n->max_totalneigh = 0;
+  n->d_numneigh = n->numneigh = NULL;
+  n->d_firstneigh = n->firstneigh = NULL;
+  n->d_neighbors = n->neighbors = NULL;
+  n->maxneighs = 0;
+  n->totalneigh = 0;
+  n->hostlist = 0;
+  n->ilist = n->d_ilist = n->iflag = NULL;
+  n->ninterior = 0;
+  n->max_ilist = 0;
+  n->nmax = 0;
+  n->bincount = NULL;
+  n->binstart = NULL;
+  n->binhist = NULL;
+  n->binbox = NULL;
+  n->bins = NULL;
+  n->atombin = NULL;
+  n->max_bins = 0;
+  n->stencil = NULL;
+  n->stencilxyz = NULL;
+  n->engine = NEIGH_BINS;
+  n->morton_key = n->morton_tmpkey = n->morton_cellkey = NULL;
+  n->morton_atoms = n->morton_tmpatoms = n->morton_cellstart = NULL;
+  n->morton_hist = NULL;
+  n->max_morton = 0;
+  n->threads = NULL;
+  n->halfneigh = 0;
+  n->ghost_newton = 1;
+  n->bincolor = 0;
+  n->nblocks = 0;
+  n->block_start = NULL;
+  n->block_atoms = NULL;
+  n->block_pos = NULL;
+  n->max_blocks = 0;
+  n->max_block_atoms = 0;
+  n->clusterlist = 0;
+  n->cluster_n = CLUSTER_M;
+  n->nclusters = n->nlocal_clusters = 0;
+  n->column_start = NULL;
+  n->cluster_atoms = NULL;
+  n->cluster_x = NULL;
+  n->cluster_bbox = NULL;
+  n->jcluster_bbox = NULL;
+  n->cluster_numneigh = NULL;
+  n->cluster_neighbors = NULL;
+  n->max_cluster_neighs = 32;
+  n->max_clusters = 0;
+  n->max_columns = 0;
+}
+
+void Neighbor_destroy(Neighbor *n)
+{
+  if(n->async) {
+    Neighbor* const shadow = &n->async->shadow;
+
+    Neighbor_async_finish(n, NULL, 0);
+
+    if(shadow->numneigh) free(shadow->numneigh);
+    if(shadow->firstneigh) free(shadow->firstneigh);
+    if(shadow->neighbors) free(shadow->neighbors);
+    acc_free(shadow->d_numneigh);
+    acc_free(shadow->d_firstneigh);
+    acc_free(shadow->d_neighbors);
+    free(shadow->bins);
+    free(shadow->atombin);
+    free(shadow->bincount);
+    free(shadow->binstart);
+    free(shadow->binhist);
+    free(shadow->binbox);
+
+    if(n->async->xsnap) free(n->async->xsnap);
+
+    free(n->async);
+  }
+
+  if(n->numneigh) free(n->numneigh);
+  if(n->firstneigh) free(n->firstneigh);
+  if(n->neighbors) free(n->neighbors);
+  acc_free(n->d_numneigh);
+  acc_free(n->d_firstneigh);
+  acc_free(n->d_neighbors);
+
+  if(n->outer_numneigh) free(n->outer_numneigh);
+  if(n->outer_firstneigh) free(n->outer_firstneigh);
+  if(n->outer_neighbors) free(n->outer_neighbors);
+  acc_free(n->d_outer_numneigh);
+  acc_free(n->d_outer_firstneigh);
+  acc_free(n->d_outer_neighbors);
+
+  if(n->ilist) free(n->ilist);
+  if(n->iflag) free(n->iflag);
+  acc_free(n->d_ilist);
+
+  if(n->rebuild) free(n->rebuild);
+  if(n->buildbin) free(n->buildbin);
+  if(n->dirtybin) free(n->dirtybin);
+  if(n->prev_firstneigh) free(n->prev_firstneigh);
+  if(n->prev_neighbors) free(n->prev_neighbors);
+  acc_free(n->d_rebuild);
+  acc_free(n->d_prev_firstneigh);
+  acc_free(n->d_prev_neighbors);
+
+  if(n->bincount) free(n->bincount);
+
+  if(n->binstart) free(n->binstart);
+
+  if(n->binhist) free(n->binhist);
+
+  if(n->binbox) free(n->binbox);
+
+  if(n->bins) free(n->bins);
+
+  if(n->atombin) free(n->atombin);
+
+  if(n->stencilxyz) free(n->stencilxyz);
+
+  if(n->morton_key) free(n->morton_key);
+  if(n->morton_tmpkey) free(n->morton_tmpkey);
+  if(n->morton_atoms) free(n->morton_atoms);
+  if(n->morton_tmpatoms) free(n->morton_tmpatoms);
+  if(n->morton_cellkey) free(n->morton_cellkey);
+  if(n->morton_cellstart) free(n->morton_cellstart);
+  if(n->morton_hist) free(n->morton_hist);
+
+  if(n->block_start) free(n->block_start);
+
+  if(n->block_atoms) free(n->block_atoms);
+
+  if(n->block_pos) free(n->block_pos);
+
+  if(n->column_start) free(n->column_start);
+
+  if(n->cluster_atoms) free(n->cluster_atoms);
+
+  if(n->cluster_x) free(n->cluster_x);
+
+  if(n->cluster_bbox) free(n->cluster_bbox);
+
+  if(n->jcluster_bbox) free(n->jcluster_bbox);
+
+  if(n->cluster_numneigh) free(n->cluster_numneigh);
+
+  if(n->cluster_neighbors) free(n->cluster_neighbors);
+}
+
+/* exchange the outer and the (inner) lists used by the force kernels, lets
+   the binned build and Neighbor_offsets work on the outer list */
+
+static void Neighbor_swap_outer(Neighbor *neighbor)
+{
+  int* tmp;
+  int n;
+
+  tmp = neighbor->numneigh; neighbor->numneigh = neighbor->outer_numneigh; neighbor->outer_numneigh = tmp;
+  tmp = neighbor->firstneigh; neighbor->firstneigh = neighbor->outer_firstneigh; neighbor->outer_firstneigh = tmp;
+  tmp = neighbor->neighbors; neighbor->neighbors = neighbor->outer_neighbors; neighbor->outer_neighbors = tmp;
+  tmp = neighbor->d_numneigh; neighbor->d_numneigh = neighbor->d_outer_numneigh; neighbor->d_outer_numneigh = tmp;
+  tmp = neighbor->d_firstneigh; neighbor->d_firstneigh = neighbor->d_outer_firstneigh; neighbor->d_outer_firstneigh = tmp;
+  tmp = neighbor->d_neighbors; neighbor->d_neighbors = neighbor->d_outer_neighbors; neighbor->d_outer_neighbors = tmp;
+  n = neighbor->totalneigh; neighbor->totalneigh = neighbor->outer_totalneigh; neighbor->outer_totalneigh = n;
+  n = neighbor->maxneighs; neighbor->maxneighs = neighbor->outer_maxneighs; neighbor->outer_maxneighs = n;
+  n = neighbor->max_totalneigh; neighbor->max_totalneigh = neighbor->max_outer_totalneigh; neighbor->max_outer_totalneigh = n;
+}
+
+/* count / scan / fill sweep over the stencil bins for every local atom
+   update = 1 (Neighbor_update) sweeps only the atoms flagged in rebuild, the
+   lists of all other atoms are copied from the previous lists */
+
+static void Neighbor_sweep(Neighbor *neighbor, Atom *atom, int pad, int update)
+{
+  const int nlocal = atom->nlocal;
+  const MMD_float* const restrict x_ = atom->d_x;
+
+  // previous lists stay intact in the spare buffers while the new ones are filled
+
+  if(update) {
+    int* tmp;
+    int n;
+
+    for(int i = 0; i <= nlocal; i++) neighbor->prev_firstneigh[i] = neighbor->firstneigh[i];
+
+    Atom_sync_device(atom, neighbor->d_prev_firstneigh, neighbor->prev_firstneigh, (nlocal + 1) * sizeof(int));
+    Atom_sync_device(atom, neighbor->d_rebuild, neighbor->rebuild, nlocal * sizeof(int));
+
+    tmp = neighbor->neighbors; neighbor->neighbors = neighbor->prev_neighbors; neighbor->prev_neighbors = tmp;
+    tmp = neighbor->d_neighbors; neighbor->d_neighbors = neighbor->d_prev_neighbors; neighbor->d_prev_neighbors = tmp;
+    n = neighbor->max_totalneigh; neighbor->max_totalneigh = neighbor->max_prev_totalneigh; neighbor->max_prev_totalneigh = n;
+  }
+
+  /* loop over each atom, counting (fill = 0) or storing (fill = 1) neighbors */
+
+  for(int fill = 0; fill < 2; fill++) {
+    if(fill) Neighbor_offsets(neighbor, atom, pad);
+
+    int* const restrict neighbors_ = neighbor->d_neighbors;
+    int* const restrict numneigh_ = neighbor->d_numneigh;
+    const int* const restrict firstneigh_ = neighbor->d_firstneigh;
+    const int* const restrict rebuild_ = neighbor->d_rebuild;
+    const int* const restrict prevneighbors_ = neighbor->d_prev_neighbors;
+    const int* const restrict prevfirst_ = neighbor->d_prev_firstneigh;
+    const int update_ = update;
+    const int* const restrict bins_ = neighbor->bins;
+    const int* const restrict binstart_ = neighbor->binstart;
+    const int* const restrict bincount_ = neighbor->bincount;
+    const MMD_float* const restrict binbox_ = neighbor->binbox;
+    const int* const restrict stencil_ = neighbor->stencil;
+    const int fill_ = fill;
+    const int pad_ = pad;
+    const int nlocal_ = nlocal;
+    const int stride_ = DS1(neighbor->nmax, neighbor->maxneighs);
+    const MMD_float xprd_ = neighbor->xprd;
+    const MMD_float yprd_ = neighbor->yprd;
+    const MMD_float zprd_ = neighbor->zprd;
+    const int nbinx_ = neighbor->nbinx;
+    const int nbiny_ = neighbor->nbiny;
+    const int nbinz_ = neighbor->nbinz;
+    const int mbinx_ = neighbor->mbinx;
+    const int mbiny_ = neighbor->mbiny;
+    const int mbinz_ = neighbor->mbinz;
+    const MMD_float mbinxlo_ = neighbor->mbinxlo;
+    const MMD_float mbinylo_ = neighbor->mbinylo;
+    const MMD_float mbinzlo_ = neighbor->mbinzlo;
+    const MMD_float bininvx_ = neighbor->bininvx;
+    const MMD_float bininvy_ = neighbor->bininvy;
+    const MMD_float bininvz_ = neighbor->bininvz;
+    const int nstencil_ = neighbor->nstencil; 
+    const int halfneigh_ = neighbor->halfneigh;
+    const int ghost_newton_ = neighbor->ghost_newton;
+    const MMD_float cutneighsq_ = neighbor->cutneighsq;
+
+    #pragma acc kernels deviceptr(x_,numneigh_,neighbors_,firstneigh_,rebuild_,prevneighbors_,prevfirst_) copyin(bins_[0:neighbor->binstart[neighbor->mbins]],binstart_[0:neighbor->mbins+1],bincount_[0:neighbor->mbins],binbox_[0:6*neighbor->mbins],stencil_[0:nstencil_])
+    for(int i = 0; i < nlocal_; i++) {
+      const int first = fill_ ? FIRSTNEIGH(firstneigh_, i) : 0;
+
+      // incremental update: keep (copy) the lists of the atoms away from dirty bins
+
+      if(update_ && !rebuild_[i]) {
+        if(fill_) {
+          const int pfirst = FIRSTNEIGH(prevfirst_, i);
+
+          for(int k = 0; k < (numneigh_[i] + pad_ - 1) / pad_ * pad_; k++)
+            neighbors_[first + k * stride_] = prevneighbors_[pfirst + k * stride_];
+        }
+
+        continue;
+      }
+
+      int n = 0;
+
+      const MMD_float xtmp = x_[i * PAD + 0];
+      const MMD_float ytmp = x_[i * PAD + 1];
+      const MMD_float ztmp = x_[i * PAD + 2];
+
+      /* loop over atoms in i's bin,
+      */
+
+      int ibin; 
+      {
+        int ix, iy, iz;
+
+        if(xtmp >= xprd_)
+          ix = (int)((xtmp - xprd_) * bininvx_) + nbinx_ - mbinxlo_;
+        else if(xtmp >= 0.0)
+          ix = (int)(xtmp * bininvx_) - mbinxlo_;
+        else
+          ix = (int)(xtmp * bininvx_) - mbinxlo_ - 1;
+
+        if(ytmp >= yprd_)
+          iy = (int)((ytmp - yprd_) * bininvy_) + nbiny_ - mbinylo_;
+        else if(ytmp >= 0.0)
+          iy = (int)(ytmp * bininvy_) - mbinylo_;
+        else
+          iy = (int)(ytmp * bininvy_) - mbinylo_ - 1;
+
+        if(ztmp >= zprd_)
+          iz = (int)((ztmp - zprd_) * bininvz_) + nbinz_ - mbinzlo_;
+        else if(ztmp >= 0.0)
+          iz = (int)(ztmp * bininvz_) - mbinzlo_;
+        else
+          iz = (int)(ztmp * bininvz_) - mbinzlo_ - 1;
+        ibin = (iz * mbiny_ * mbinx_ + iy * mbinx_ + ix + 1);
+      }
+
+      for(int k = 0; k < nstencil_; k++) {
+        const int jbin = ibin + stencil_[k];
+
+        const int* restrict loc_bin = &bins_[binstart_[jbin]];
+
+        if(ibin == jbin)
+          for(int m = 0; m < bincount_[jbin]; m++) {
+            const int j = loc_bin[m];
+
+            //for same bin as atom i skip j if i==j and skip atoms "below and to the left" if using halfneighborlists
+            if(((j == i) || (halfneigh_ && !ghost_newton_ && (j < i)) ||
+                (halfneigh_ && ghost_newton_ && ((j < i) || ((j >= nlocal_) &&
+                                               ((x_[j * PAD + 2] < ztmp) || (x_[j * PAD + 2] == ztmp && x_[j * PAD + 1] < ytmp) ||
+                                                (x_[j * PAD + 2] == ztmp && x_[j * PAD + 1]  == ytmp && x_[j * PAD + 0] < xtmp))))))) continue;
+
+            const MMD_float delx = xtmp - x_[j * PAD + 0];
+            const MMD_float dely = ytmp - x_[j * PAD + 1];
+            const MMD_float delz = ztmp - x_[j * PAD + 2];
+            const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+
+            if((rsq <= cutneighsq_)) {
+              if(fill_) neighbors_[first + n * stride_] = j;
+
+              n++;
+            }
+          }
+        else {
+          // skip the whole bin if its atoms all lie beyond the cutoff
+          // (distance to the box of its atoms, plain selects compile to max instructions)
+
+          const MMD_float* const box = &binbox_[6 * jbin];
+          MMD_float dx = box[0] - xtmp > xtmp - box[3] ? box[0] - xtmp : xtmp - box[3];
+          MMD_float dy = box[1] - ytmp > ytmp - box[4] ? box[1] - ytmp : ytmp - box[4];
+          MMD_float dz = box[2] - ztmp > ztmp - box[5] ? box[2] - ztmp : ztmp - box[5];
+          dx = dx > 0.0 ? dx : 0.0;
+          dy = dy > 0.0 ? dy : 0.0;
+          dz = dz > 0.0 ? dz : 0.0;
+
+          if(dx * dx + dy * dy + dz * dz > cutneighsq_) continue;
+
+          for(int m = 0; m < bincount_[jbin]; m++) {
+            const int j = loc_bin[m];
+
+            if(halfneigh_ && !ghost_newton_ && (j < i)) continue;
+
+            const MMD_float delx = xtmp - x_[j * PAD + 0];
+            const MMD_float dely = ytmp - x_[j * PAD + 1];
+            const MMD_float delz = ztmp - x_[j * PAD + 2];
+            const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+
+            if((rsq <= cutneighsq_)) {
+              if(fill_) neighbors_[first + n * stride_] = j;
+
+              n++;
+            }
+          }
+        }
+      }
+
+      if(fill_)
+        for(int k = n; k < (n + pad_ - 1) / pad_ * pad_; k++)
+          neighbors_[first + k * stride_] = i;
+      else
+        numneigh_[i] = n;
+    }
+  }
+
+}
+
+/* Morton key of a cell: the bits of the x, y and z cell coordinates interleaved */
+
+static inline unsigned int Neighbor_morton_spread(unsigned int v)
+{
+  v = (v | (v << 16)) & 0x030000FF;
+  v = (v | (v << 8)) & 0x0300F00F;
+  v = (v | (v << 4)) & 0x030C30C3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+static inline unsigned int Neighbor_morton_compact(unsigned int v)
+{
+  v &= 0x09249249;
+  v = (v | (v >> 2)) & 0x030C30C3;
+  v = (v | (v >> 4)) & 0x0300F00F;
+  v = (v | (v >> 8)) & 0x030000FF;
+  v = (v | (v >> 16)) & 0x000003FF;
+  return v;
+}
+
+static inline unsigned int Neighbor_morton(int ix, int iy, int iz)
+{
+  return Neighbor_morton_spread(ix) | (Neighbor_morton_spread(iy) << 1) | (Neighbor_morton_spread(iz) << 2);
+}
+
+/* cell of an atom: its bin coordinates (Neighbor_coord2bin) shifted by one */
+
+static inline unsigned int Neighbor_coord2key(Neighbor *neighbor, MMD_float x, MMD_float y, MMD_float z)
+{
+  int ix, iy, iz;
+
+  if(x >= neighbor->xprd)
+    ix = (int)((x - neighbor->xprd) * neighbor->bininvx) + neighbor->nbinx - neighbor->mbinxlo;
+  else if(x >= 0.0)
+    ix = (int)(x * neighbor->bininvx) - neighbor->mbinxlo;
+  else
+    ix = (int)(x * neighbor->bininvx) - neighbor->mbinxlo - 1;
+
+  if(y >= neighbor->yprd)
+    iy = (int)((y - neighbor->yprd) * neighbor->bininvy) + neighbor->nbiny - neighbor->mbinylo;
+  else if(y >= 0.0)
+    iy = (int)(y * neighbor->bininvy) - neighbor->mbinylo;
+  else
+    iy = (int)(y * neighbor->bininvy) - neighbor->mbinylo - 1;
+
+  if(z >= neighbor->zprd)
+    iz = (int)((z - neighbor->zprd) * neighbor->bininvz) + neighbor->nbinz - neighbor->mbinzlo;
+  else if(z >= 0.0)
+    iz = (int)(z * neighbor->bininvz) - neighbor->mbinzlo;
+  else
+    iz = (int)(z * neighbor->bininvz) - neighbor->mbinzlo - 1;
+
+  return Neighbor_morton(ix + 1, iy + 1, iz + 1);
+}
+
+/* occupied cell with the given key (binary search), -1 if there is none */
+
+static inline int Neighbor_morton_find(const unsigned int* cellkey, int ncells, unsigned int key)
+{
+  int lo = 0;
+  int hi = ncells;
+
+  while(lo < hi) {
+    const int mid = (lo + hi) / 2;
+
+    if(cellkey[mid] < key) lo = mid + 1;
+    else hi = mid;
+  }
+
+  return (lo < ncells && cellkey[lo] == key) ? lo : -1;
+}
+
+/* stable order of the first count atoms (all for count < 0) by the Morton
+   key of their cell: LSD radix sort, 8 bit digits, per thread histograms;
+   morton_atoms holds the atoms in key order, morton_key their keys
+   returns 0 (and sorts nothing) if the bin grid does not fit into the keys */
+
+int Neighbor_sort_morton(Neighbor *neighbor, Atom *atom, int count)
+{
+  const int num_omp_threads = neighbor->threads->omp_num_threads;
+  const int nall = count < 0 ? atom->nlocal + atom->nghost : count;
+  const MMD_float* const restrict x = &atom->x[0][0];
+  const int mbinmax = MAX(neighbor->mbinx, MAX(neighbor->mbiny, neighbor->mbinz));
+
+  if(mbinmax + 2 > (1 << MORTON_BITS)) return 0;
+
+  neighbor->xprd = atom->box.xprd;
+  neighbor->yprd = atom->box.yprd;
+  neighbor->zprd = atom->box.zprd;
+
+  if(nall > neighbor->max_morton) {
+    if(neighbor->morton_key) free(neighbor->morton_key);
+    if(neighbor->morton_tmpkey) free(neighbor->morton_tmpkey);
+    if(neighbor->morton_atoms) free(neighbor->morton_atoms);
+    if(neighbor->morton_tmpatoms) free(neighbor->morton_tmpatoms);
+    if(neighbor->morton_cellkey) free(neighbor->morton_cellkey);
+    if(neighbor->morton_cellstart) free(neighbor->morton_cellstart);
+
+    neighbor->max_morton = nall * 1.2;
+    neighbor->morton_key = (unsigned int*) malloc(neighbor->max_morton * sizeof(unsigned int));
+    neighbor->morton_tmpkey = (unsigned int*) malloc(neighbor->max_morton * sizeof(unsigned int));
+    neighbor->morton_atoms = (int*) malloc(neighbor->max_morton * sizeof(int));
+    neighbor->morton_tmpatoms = (int*) malloc(neighbor->max_morton * sizeof(int));
+    neighbor->morton_cellkey = (unsigned int*) malloc(neighbor->max_morton * sizeof(unsigned int));
+    neighbor->morton_cellstart = (int*) malloc((neighbor->max_morton + 1) * sizeof(int));
+  }
+
+  // radix passes for the bits actually used by the keys
+
+  int bits = 1;
+
+  while((1 << bits) < mbinmax + 2) bits++;
+
+  const int npasses = (3 * bits + 7) / 8;
+
+  int* const restrict mhist = neighbor->morton_hist;
+
+  #pragma omp parallel num_threads(num_omp_threads)
+  {
+    int* const restrict hist = &mhist[omp_get_thread_num() * 256];
+    const int nthreads = omp_get_num_threads();
+    unsigned int* restrict key = neighbor->morton_key;
+    unsigned int* restrict tmpkey = neighbor->morton_tmpkey;
+    int* restrict atoms = neighbor->morton_atoms;
+    int* restrict tmpatoms = neighbor->morton_tmpatoms;
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nall; i++) {
+      key[i] = Neighbor_coord2key(neighbor, x[i * PAD + 0], x[i * PAD + 1], x[i * PAD + 2]);
+      atoms[i] = i;
+    }
+
+    for(int pass = 0; pass < npasses; pass++) {
+      const int shift = 8 * pass;
+
+      for(int d = 0; d < 256; d++) hist[d] = 0;
+
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nall; i++) hist[(key[i] >> shift) & 255]++;
+
+      #pragma omp single
+      {
+        int pos = 0;
+
+        for(int d = 0; d < 256; d++)
+          for(int t = 0; t < nthreads; t++) {
+            const int n = mhist[t * 256 + d];
+            mhist[t * 256 + d] = pos;
+            pos += n;
+          }
+      }
+
+      // same static schedule as the histogram loop keeps the sort stable
+
+      #pragma omp for schedule(static)
+      for(int i = 0; i < nall; i++) {
+        const int pos = hist[(key[i] >> shift) & 255]++;
+        tmpkey[pos] = key[i];
+        tmpatoms[pos] = atoms[i];
+      }
+
+      unsigned int* const swapkey = key; key = tmpkey; tmpkey = swapkey;
+      int* const swapatoms = atoms; atoms = tmpatoms; tmpatoms = swapatoms;
+    }
+  }
+
+  // the sort ends in the tmp buffers after an odd # of passes
+
+  if(npasses % 2) {
+    unsigned int* const tmpkey = neighbor->morton_key;
+    neighbor->morton_key = neighbor->morton_tmpkey;
+    neighbor->morton_tmpkey = tmpkey;
+    int* const tmpatoms = neighbor->morton_atoms;
+    neighbor->morton_atoms = neighbor->morton_tmpatoms;
+    neighbor->morton_tmpatoms = tmpatoms;
+  }
+
+  return 1;
+}
+
+/* Morton-key engine (--neigh_engine morton), a host build:
+   all atoms are sorted by the Morton key of their cell (Neighbor_sort_morton),
+   the occupied cells are the runs of equal keys; the cells of the stencil around an occupied cell
+   are found by a binary search of their keys and their atoms scanned in
+   sorted order, cells are visited in stencil order and hold their atoms in
+   index order, so the lists equal the ones of Neighbor_sweep
+   no bin capacity and no empty bins: memory and work follow the atoms, not
+   the volume of the box (voids, clusters in vacuum) */
+
+static void Neighbor_build_morton(Neighbor *neighbor, Atom *atom, int pad)
+{
+  const int num_omp_threads = neighbor->threads->omp_num_threads;
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const MMD_float* const restrict x = &atom->x[0][0];
+
+  Neighbor_sort_morton(neighbor, atom, -1);
+
+  // occupied cells: runs of equal keys
+
+  const unsigned int* const restrict key = neighbor->morton_key;
+  const int* const restrict atoms = neighbor->morton_atoms;
+  unsigned int* const restrict cellkey = neighbor->morton_cellkey;
+  int* const restrict cellstart = neighbor->morton_cellstart;
+  int ncells = 0;
+
+  for(int m = 0; m < nall; m++)
+    if(m == 0 || key[m] != key[m - 1]) {
+      cellkey[ncells] = key[m];
+      cellstart[ncells++] = m;
+    }
+
+  cellstart[ncells] = nall;
+
+  /* loop over the occupied cells, counting (fill = 0) or storing (fill = 1)
+     the neighbors of their local atoms */
+
+  for(int fill = 0; fill < 2; fill++) {
+    if(fill) {
+      Atom_sync_device(atom, neighbor->d_numneigh, neighbor->numneigh, nlocal * sizeof(int));
+      Neighbor_offsets(neighbor, atom, pad);
+    }
+
+    int* const restrict neighbors = neighbor->neighbors;
+    int* const restrict numneigh = neighbor->numneigh;
+    const int* const restrict firstneigh = neighbor->firstneigh;
+    const int* const restrict stencilxyz = neighbor->stencilxyz;
+    const int nstencil = neighbor->nstencil;
+    const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
+    const int halfneigh = neighbor->halfneigh;
+    const int ghost_newton = neighbor->ghost_newton;
+    const MMD_float cutneighsq = neighbor->cutneighsq;
+    const int cellmax = (1 << MORTON_BITS) - 1;
+
+    #pragma omp parallel num_threads(num_omp_threads)
+    {
+      int* const restrict jcells = (int*) malloc(nstencil * sizeof(int));
+
+      #pragma omp for schedule(dynamic, 16)
+      for(int c = 0; c < ncells; c++) {
+        // locals come first in a cell
+
+        if(atoms[cellstart[c]] >= nlocal) continue;
+
+        const int ix = Neighbor_morton_compact(cellkey[c]);
+        const int iy = Neighbor_morton_compact(cellkey[c] >> 1);
+        const int iz = Neighbor_morton_compact(cellkey[c] >> 2);
+
+        for(int k = 0; k < nstencil; k++) {
+          const int jx = ix + stencilxyz[3 * k + 0];
+          const int jy = iy + stencilxyz[3 * k + 1];
+          const int jz = iz + stencilxyz[3 * k + 2];
+
+          if(jx < 0 || jy < 0 || jz < 0 || jx > cellmax || jy > cellmax || jz > cellmax)
+            jcells[k] = -1;
+          else
+            jcells[k] = Neighbor_morton_find(cellkey, ncells, Neighbor_morton(jx, jy, jz));
+        }
+
+        for(int mi = cellstart[c]; mi < cellstart[c + 1] && atoms[mi] < nlocal; mi++) {
+          const int i = atoms[mi];
+          const int first = fill ? FIRSTNEIGH(firstneigh, i) : 0;
+          const MMD_float xtmp = x[i * PAD + 0];
+          const MMD_float ytmp = x[i * PAD + 1];
+          const MMD_float ztmp = x[i * PAD + 2];
+          int n = 0;
+
+          for(int k = 0; k < nstencil; k++) {
+            const int jc = jcells[k];
+
+            if(jc < 0) continue;
+
+            for(int m = cellstart[jc]; m < cellstart[jc + 1]; m++) {
+              const int j = atoms[m];
+
+              // same rules as Neighbor_sweep
+
+              if(jc == c) {
+                if(((j == i) || (halfneigh && !ghost_newton && (j < i)) ||
+                    (halfneigh && ghost_newton && ((j < i) || ((j >= nlocal) &&
+                                                   ((x[j * PAD + 2] < ztmp) || (x[j * PAD + 2] == ztmp && x[j * PAD + 1] < ytmp) ||
+                                                    (x[j * PAD + 2] == ztmp && x[j * PAD + 1]  == ytmp && x[j * PAD + 0] < xtmp))))))) continue;
+              } else if(halfneigh && !ghost_newton && (j < i)) continue;
+
+              const MMD_float delx = xtmp - x[j * PAD + 0];
+              const MMD_float dely = ytmp - x[j * PAD + 1];
+              const MMD_float delz = ztmp - x[j * PAD + 2];
+              const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+
+              if((rsq <= cutneighsq)) {
+                if(fill) neighbors[first + n * stride] = j;
+
+                n++;
+              }
+            }
+          }
+
+          if(fill)
+            for(int k = n; k < (n + pad - 1) / pad * pad; k++)
+              neighbors[first + k * stride] = i;
+          else
+            numneigh[i] = n;
+        }
+      }
+
+      free(jcells);
+    }
+  }
+
+  Atom_sync_device(atom, neighbor->d_neighbors, neighbor->neighbors, neighbor->totalneigh * sizeof(int));
+}
+
+/* per atom arrays of the lists for nall atoms */
+
+static void Neighbor_grow(Neighbor *neighbor, int nall)
+{
+  if(nall > neighbor->nmax) {
+    neighbor->nmax = nall;
+
+    if(neighbor->numneigh) free(neighbor->numneigh);
+    if(neighbor->firstneigh) free(neighbor->firstneigh);
+    acc_free(neighbor->d_numneigh);
+    acc_free(neighbor->d_firstneigh);
+
+    neighbor->numneigh = (int*) malloc(neighbor->nmax * sizeof(int));
+    neighbor->firstneigh = (int*) malloc((neighbor->nmax + 1) * sizeof(int));
+    neighbor->d_numneigh = (int*) acc_malloc(neighbor->nmax * sizeof(int));
+    neighbor->d_firstneigh = (int*) acc_malloc((neighbor->nmax + 1) * sizeof(int));
+
+    if(neighbor->outer) {
+      if(neighbor->outer_numneigh) free(neighbor->outer_numneigh);
+      if(neighbor->outer_firstneigh) free(neighbor->outer_firstneigh);
+      acc_free(neighbor->d_outer_numneigh);
+      acc_free(neighbor->d_outer_firstneigh);
+
+      neighbor->outer_numneigh = (int*) malloc(neighbor->nmax * sizeof(int));
+      neighbor->outer_firstneigh = (int*) malloc((neighbor->nmax + 1) * sizeof(int));
+      neighbor->d_outer_numneigh = (int*) acc_malloc(neighbor->nmax * sizeof(int));
+      neighbor->d_outer_firstneigh = (int*) acc_malloc((neighbor->nmax + 1) * sizeof(int));
+    }
+
+    if(neighbor->incremental) {
+      if(neighbor->rebuild) free(neighbor->rebuild);
+      if(neighbor->buildbin) free(neighbor->buildbin);
+      if(neighbor->prev_firstneigh) free(neighbor->prev_firstneigh);
+      acc_free(neighbor->d_rebuild);
+      acc_free(neighbor->d_prev_firstneigh);
+
+      neighbor->rebuild = (int*) malloc(neighbor->nmax * sizeof(int));
+      neighbor->buildbin = (int*) malloc(neighbor->nmax * sizeof(int));
+      neighbor->prev_firstneigh = (int*) malloc((neighbor->nmax + 1) * sizeof(int));
+      neighbor->d_rebuild = (int*) acc_malloc(neighbor->nmax * sizeof(int));
+      neighbor->d_prev_firstneigh = (int*) acc_malloc((neighbor->nmax + 1) * sizeof(int));
+    }
+  }
+
+}
+
+/* binned neighbor list construction with full Newton's 3rd law
+   every pair stored exactly once by some processor
+   each owned atom i checks its own bin and other bins in Newton stencil
+   two passes over the same loop: the first one only counts the neighbors
+   of each atom, Neighbor_offsets turns the counts into the offsets of the
+   packed (CSR) lists with an exclusive scan, the second pass fills them
+   with USELAYOUTLEFT (device build) the lists stay a nmax x maxneighs
+   rectangle with the atom index fastest, maxneighs is the largest count
+   with outer lists (cutneigh = outer cutoff) the binned sweep builds the
+   outer list and the lists of the force kernels are filtered from it */
+
+void Neighbor_build(Neighbor *neighbor, Atom *atom)
+{
+  neighbor->ncalls++;
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  /* extend atom arrays if necessary */
+
+  Neighbor_grow(neighbor, nall);
+
+  /* bin local & ghost atoms (the Morton engine only needs bins for colors and clusters) */
+  const int morton = neighbor->engine == NEIGH_MORTON && !neighbor->clusterlist;
+
+  if(!morton || neighbor->bincolor || neighbor->incremental)
+    Neighbor_binatoms(neighbor, atom, -1);
+
+  neighbor->count = 0;
+
+  MMD_float* const restrict x_ = atom->d_x;
+  Atom_sync_device(atom, x_, &atom->x[0][0], atom->nmax*PAD*sizeof(MMD_float));
+
+  // reference positions for Neighbor_check_distance / _check_ghosts
+
+  if(neighbor->check || neighbor->outer || neighbor->incremental || neighbor->async_build) {
+    MMD_float* const restrict xold_ = atom->d_xold;
+
+    #pragma acc kernels deviceptr(x_,xold_)
+    for(int i = 0; i < nlocal * PAD; i++)
+      xold_[i] = x_[i];
+  }
+
+  // reference positions and bins of all atoms for Neighbor_update
+
+  if(neighbor->incremental) {
+    const MMD_float* const x = &atom->x[0][0];
+    MMD_float* const xold = &atom->xold[0][0];
+
+    #pragma omp parallel for
+    for(int i = 0; i < nall; i++) {
+      xold[i * PAD + 0] = x[i * PAD + 0];
+      xold[i * PAD + 1] = x[i * PAD + 1];
+      xold[i * PAD + 2] = x[i * PAD + 2];
+      neighbor->buildbin[i] = neighbor->atombin[i];
+    }
+  }
+
+  // the cluster pair lists replace the atom lists for the cluster kernels
+
+  if(neighbor->clusterlist) {
+    Neighbor_build_clusters(neighbor, atom);
+    return;
+  }
+
+  // pad the lists with i up to a multiple of CHUNKSIZE for the intrinsics kernels
+
+  const int pad = neighbor->hostlist && !neighbor->outer ? CHUNKSIZE : 1;
+
+  if(neighbor->outer) Neighbor_swap_outer(neighbor);
+
+  if(morton)
+    Neighbor_build_morton(neighbor, atom, pad);
+  else
+    Neighbor_sweep(neighbor, atom, pad, 0);
+
+  // host copy of the lists for the host kernels (half neighborlists, intrinsics)
+
+  if(neighbor->outer) {
+    Neighbor_swap_outer(neighbor);
+    Neighbor_build_inner(neighbor, atom);
+  } else if((neighbor->halfneigh || neighbor->hostlist) && !morton)
+    Atom_sync_host(atom, neighbor->neighbors, neighbor->d_neighbors, neighbor->totalneigh * sizeof(int));
+
+  if(neighbor->bincolor)
+    Neighbor_build_colors(neighbor, atom);
+}
+
+/* incremental update between full rebuilds (same local and ghost atoms, no
+   exchange / borders): a bin is dirty if an atom entered or left it or one of
+   its atoms moved more than skin/2 since the last Neighbor_build; local atoms
+   within stencil reach (both directions) of a dirty bin get a new list from
+   the binned sweep, all other lists are still complete and are kept
+   only while the ghosts are complete (Neighbor_check_ghosts, the integrator
+   does a full rebuild otherwise)
+   not with ghost newton half lists: the owner of a local-ghost pair in the
+   same bin depends on positions on both processors */
+
+void Neighbor_update(Neighbor *neighbor, Atom *atom)
+{
+  const int nlocal = atom->nlocal;
+  const int nall = atom->nlocal + atom->nghost;
+  const int mbins = neighbor->mbins;
+  const int nstencil = neighbor->nstencil;
+  const int* const stencil = neighbor->stencil;
+  const MMD_float triggersq = 0.25 * neighbor->skin * neighbor->skin;
+
+  Atom_sync_host(atom, &atom->x[0][0], atom->d_x, nall * PAD * sizeof(MMD_float));
+
+  Neighbor_binatoms(neighbor, atom, -1);
+
+  const MMD_float* const x = &atom->x[0][0];
+  const MMD_float* const xold = &atom->xold[0][0];
+  const int* const atombin = neighbor->atombin;
+  const int* const buildbin = neighbor->buildbin;
+  int* const dirtybin = neighbor->dirtybin;
+  int* const rebuild = neighbor->rebuild;
+  int nupdated = 0;
+
+  for(int ibin = 0; ibin < mbins; ibin++) dirtybin[ibin] = 0;
+
+  #pragma omp parallel for
+  for(int i = 0; i < nall; i++) {
+    const MMD_float delx = x[i * PAD + 0] - xold[i * PAD + 0];
+    const MMD_float dely = x[i * PAD + 1] - xold[i * PAD + 1];
+    const MMD_float delz = x[i * PAD + 2] - xold[i * PAD + 2];
+    const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+
+    if(atombin[i] != buildbin[i] || rsq > triggersq) {
+      dirtybin[atombin[i]] = 1;
+      dirtybin[buildbin[i]] = 1;
+    }
+  }
+
+  #pragma omp parallel for reduction(+:nupdated)
+  for(int i = 0; i < nlocal; i++) {
+    const int ibin = atombin[i];
+    int dirty = dirtybin[ibin];
+
+    for(int k = 0; k < nstencil && !dirty; k++)
+      dirty = dirtybin[ibin + stencil[k]] || dirtybin[ibin - stencil[k]];
+
+    rebuild[i] = dirty;
+    nupdated += dirty;
+  }
+
+  neighbor->nupdated += nupdated;
+
+  Neighbor_sweep(neighbor, atom, neighbor->hostlist ? CHUNKSIZE : 1, 1);
+
+  if(neighbor->halfneigh || neighbor->hostlist)
+    Atom_sync_host(atom, neighbor->neighbors, neighbor->d_neighbors, neighbor->totalneigh * sizeof(int));
+
+  if(neighbor->bincolor)
+    Neighbor_build_colors(neighbor, atom);
+}
+
+/* the shadow owns its lists and bins and copies everything else from the
+   main Neighbor; the stencil etc. are shared, colors and clusters unused */
+
+static void Neighbor_async_sync_config(Neighbor *shadow, Neighbor *neighbor)
+{
+  Neighbor own = *shadow;
+
+  *shadow = *neighbor;
+  shadow->numneigh = own.numneigh;
+  shadow->firstneigh = own.firstneigh;
+  shadow->neighbors = own.neighbors;
+  shadow->d_numneigh = own.d_numneigh;
+  shadow->d_firstneigh = own.d_firstneigh;
+  shadow->d_neighbors = own.d_neighbors;
+  shadow->totalneigh = own.totalneigh;
+  shadow->maxneighs = own.maxneighs;
+  shadow->max_totalneigh = own.max_totalneigh;
+  shadow->nmax = own.nmax;
+  shadow->bins = own.bins;
+  shadow->atombin = own.atombin;
+  shadow->bincount = own.bincount;
+  shadow->binstart = own.binstart;
+  shadow->binhist = own.binhist;
+  shadow->binbox = own.binbox;
+  shadow->max_bins = own.max_bins;
+  shadow->threads = own.threads;
+  shadow->async = NULL;
+  shadow->cutneighsq = neighbor->cutneigh * neighbor->cutneigh;
+  shadow->bincolor = 0;
+  shadow->clusterlist = 0;
+  shadow->check = 0;
+  shadow->outer = 0;
+  shadow->incremental = 0;
+}
+
+static void* Neighbor_async_run(void *arg)
+{
+  NeighborAsync* const async = (NeighborAsync*) arg;
+  Neighbor* const shadow = &async->shadow;
+  Atom* const atom = &async->atom;
+
+  // the current device is per host thread
+
+  acc_set_device_num(async->device, acc_get_device_type());
+
+  Neighbor_grow(shadow, atom->nlocal + atom->nghost);
+  Neighbor_binatoms(shadow, atom, -1);
+  Neighbor_sweep(shadow, atom, shadow->hostlist ? CHUNKSIZE : 1, 0);
+
+  if(shadow->halfneigh || shadow->hostlist)
+    Atom_sync_host(atom, shadow->neighbors, shadow->d_neighbors, shadow->totalneigh * sizeof(int));
+
+  return NULL;
+}
+
+/* snapshot the current positions of the local and ghost atoms (between full
+   rebuilds, so the indices stay valid) and build the next lists from it on
+   the helper thread, host builds only */
+
+void Neighbor_async_start(Neighbor *neighbor, Atom *atom)
+{
+  const int nall = atom->nlocal + atom->nghost;
+
+  if(neighbor->async == NULL) {
+    NeighborAsync* const async = (NeighborAsync*) malloc(sizeof(NeighborAsync));
+
+    async->running = 0;
+    async->ready = 0;
+    async->xsnap = NULL;
+    async->max_snap = 0;
+    async->device = acc_get_device_num(acc_get_device_type());
+    async->threads = *neighbor->threads;
+    async->threads.omp_num_threads = 1;
+    async->mbins = 0;
+    Neighbor_init(&async->shadow);
+    async->shadow.threads = &async->threads;
+    neighbor->async = async;
+  }
+
+  NeighborAsync* const async = neighbor->async;
+
+  // bins of the shadow (again after a setup for a larger extra skin)
+
+  if(neighbor->mbins != async->mbins) {
+    free(async->shadow.binhist);
+    free(async->shadow.binbox);
+    free(async->shadow.bincount);
+    free(async->shadow.binstart);
+
+    async->mbins = neighbor->mbins;
+    async->shadow.binhist = (int*) malloc(neighbor->mbins * sizeof(int));
+    async->shadow.binbox = (MMD_float*) malloc(6 * neighbor->mbins * sizeof(MMD_float));
+    async->shadow.bincount = (int*) malloc(neighbor->mbins * sizeof(int));
+    async->shadow.binstart = (int*) malloc((neighbor->mbins + 1) * sizeof(int));
+  }
+
+  if(nall > async->max_snap) {
+    if(async->xsnap) free(async->xsnap);
+
+    async->max_snap = nall * 1.2;
+    async->xsnap = (MMD_float*) malloc(async->max_snap * PAD * sizeof(MMD_float));
+  }
+
+  Atom_sync_host(atom, async->xsnap, atom->d_x, nall * PAD * sizeof(MMD_float));
+
+  async->atom = *atom;
+  async->atom.d_x = async->xsnap;
+  async->atom.x = &async->atom.d_x;
+  Neighbor_async_sync_config(&async->shadow, neighbor);
+
+  async->ready = 1;
+  async->running = pthread_create(&async->thread, NULL, Neighbor_async_run, async) == 0;
+
+  if(!async->running) Neighbor_async_run(async);
+}
+
+/* wait for the helper thread and (swap = 1) make its lists and bins the
+   current ones; the old ones are reused by the next background build */
+
+void Neighbor_async_finish(Neighbor *neighbor, Atom *atom, int swap)
+{
+  NeighborAsync* const async = neighbor->async;
+
+  if(async == NULL || !async->ready) return;
+
+  if(async->running) pthread_join(async->thread, NULL);
+
+  async->running = 0;
+  async->ready = 0;
+
+  if(!swap) return;
+
+  Neighbor* const shadow = &async->shadow;
+  Neighbor tmp = *neighbor;
+
+  neighbor->numneigh = shadow->numneigh;
+  neighbor->firstneigh = shadow->firstneigh;
+  neighbor->neighbors = shadow->neighbors;
+  neighbor->d_numneigh = shadow->d_numneigh;
+  neighbor->d_firstneigh = shadow->d_firstneigh;
+  neighbor->d_neighbors = shadow->d_neighbors;
+  neighbor->totalneigh = shadow->totalneigh;
+  neighbor->maxneighs = shadow->maxneighs;
+  neighbor->max_totalneigh = shadow->max_totalneigh;
+  neighbor->nmax = shadow->nmax;
+  neighbor->bins = shadow->bins;
+  neighbor->atombin = shadow->atombin;
+  neighbor->bincount = shadow->bincount;
+  neighbor->binstart = shadow->binstart;
+  neighbor->binbox = shadow->binbox;
+  neighbor->max_bins = shadow->max_bins;
+
+  shadow->numneigh = tmp.numneigh;
+  shadow->firstneigh = tmp.firstneigh;
+  shadow->neighbors = tmp.neighbors;
+  shadow->d_numneigh = tmp.d_numneigh;
+  shadow->d_firstneigh = tmp.d_firstneigh;
+  shadow->d_neighbors = tmp.d_neighbors;
+  shadow->totalneigh = tmp.totalneigh;
+  shadow->maxneighs = tmp.maxneighs;
+  shadow->max_totalneigh = tmp.max_totalneigh;
+  shadow->nmax = tmp.nmax;
+  shadow->bins = tmp.bins;
+  shadow->atombin = tmp.atombin;
+  shadow->bincount = tmp.bincount;
+  shadow->binstart = tmp.binstart;
+  shadow->binbox = tmp.binbox;
+  shadow->max_bins = tmp.max_bins;
+
+  neighbor->ncalls++;
+  neighbor->nasync++;
+
+  if(neighbor->bincolor)
+    Neighbor_build_colors(neighbor, atom);
+}
+
+/* local atoms whose lists hold no ghosts (interior) first in ilist, their
+   forces do not depend on the halo exchange of the step
+   flags from the device lists, the order is made on the host */
+
+void Neighbor_split_interior(Neighbor *neighbor, Atom *atom)
+{
+  const int nlocal = atom->nlocal;
+
+  if(nlocal > neighbor->max_ilist) {
+    if(neighbor->ilist) free(neighbor->ilist);
+    if(neighbor->iflag) free(neighbor->iflag);
+    acc_free(neighbor->d_ilist);
+
+    neighbor->max_ilist = nlocal * 1.2;
+    neighbor->ilist = (int*) malloc(neighbor->max_ilist * sizeof(int));
+    neighbor->iflag = (int*) malloc(neighbor->max_ilist * sizeof(int));
+    neighbor->d_ilist = (int*) acc_malloc(neighbor->max_ilist * sizeof(int));
+  }
+
+  const int* const restrict neighbors = neighbor->d_neighbors;
+  const int* const restrict numneigh = neighbor->d_numneigh;
+  const int* const restrict firstneigh = neighbor->d_firstneigh;
+  const int stride = DS1(neighbor->nmax, neighbor->maxneighs);
+  int* const restrict flag = neighbor->d_ilist;
+
+  #pragma acc kernels deviceptr(neighbors,numneigh,firstneigh,flag)
+  for(int i = 0; i < nlocal; i++) {
+    const int* const neighs = &neighbors[FIRSTNEIGH(firstneigh, i)];
+    int ghost = 0;
+
+    for(int k = 0; k < numneigh[i]; k++)
+      ghost |= neighs[k*stride] >= nlocal;
+
+    flag[i] = ghost;
+  }
+
+  Atom_sync_host(atom, neighbor->iflag, neighbor->d_ilist, nlocal * sizeof(int));
+
+  int* const ilist = neighbor->ilist;
+  const int* const iflag = neighbor->iflag;
+  int n = 0;
+
+  for(int i = 0; i < nlocal; i++)
+    if(!iflag[i]) ilist[n++] = i;
+
+  neighbor->ninterior = n;
+
+  for(int i = 0; i < nlocal; i++)
+    if(iflag[i]) ilist[n++] = i;
+
+  Atom_sync_device(atom, neighbor->d_ilist, ilist, nlocal * sizeof(int));
+}
+
+/* lists of the force kernels (cutinner) filtered from the outer list with the
+   current positions, no binning and no exchange / borders
+   valid while no atom moved more than (cutneigh - cutinner) / 2 since the
+   last Neighbor_build (checked by the integrator before every call, which
+   rebuilds everything otherwise), same count / scan / fill passes as
+   Neighbor_build */
+
+void Neighbor_build_inner(Neighbor *neighbor, Atom *atom)
+{
+  const int nlocal = atom->nlocal;
+  const int pad = neighbor->hostlist ? CHUNKSIZE : 1;
+
+  for(int fill = 0; fill < 2; fill++) {
+    if(fill) Neighbor_offsets(neighbor, atom, pad);
+
+    const MMD_float* const restrict x_ = atom->d_x;
+    int* const restrict neighbors_ = neighbor->d_neighbors;
+    int* const restrict numneigh_ = neighbor->d_numneigh;
+    const int* const restrict firstneigh_ = neighbor->d_firstneigh;
+    const int* const restrict oneighbors_ = neighbor->d_outer_neighbors;
+    const int* const restrict onumneigh_ = neighbor->d_outer_numneigh;
+    const int* const restrict ofirstneigh_ = neighbor->d_outer_firstneigh;
+    const int fill_ = fill;
+    const int pad_ = pad;
+    const int nlocal_ = nlocal;
+    const int stride_ = DS1(neighbor->nmax, neighbor->maxneighs);
+    const MMD_float cutinnersq_ = neighbor->cutinnersq;
+
+    #pragma acc kernels deviceptr(x_,neighbors_,numneigh_,firstneigh_,oneighbors_,onumneigh_,ofirstneigh_)
+    for(int i = 0; i < nlocal_; i++) {
+      const int first = fill_ ? FIRSTNEIGH(firstneigh_, i) : 0;
+      const int* const restrict oneighs = &oneighbors_[FIRSTNEIGH(ofirstneigh_, i)];
+      const MMD_float xtmp = x_[i * PAD + 0];
+      const MMD_float ytmp = x_[i * PAD + 1];
+      const MMD_float ztmp = x_[i * PAD + 2];
+      int n = 0;
+
+      for(int k = 0; k < onumneigh_[i]; k++) {
+        const int j = oneighs[k * stride_];
+        const MMD_float delx = xtmp - x_[j * PAD + 0];
+        const MMD_float dely = ytmp - x_[j * PAD + 1];
+        const MMD_float delz = ztmp - x_[j * PAD + 2];
+        const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+
+        if(rsq <= cutinnersq_) {
+          if(fill_) neighbors_[first + n * stride_] = j;
+
+          n++;
+        }
+      }
+
+      if(fill_)
+        for(int k = n; k < (n + pad_ - 1) / pad_ * pad_; k++)
+          neighbors_[first + k * stride_] = i;
+      else
+        numneigh_[i] = n;
+    }
+  }
+
+  if(neighbor->halfneigh || neighbor->hostlist)
+    Atom_sync_host(atom, neighbor->neighbors, neighbor->d_neighbors, neighbor->totalneigh * sizeof(int));
+}
+
+/* largest displacement of a local atom on any rank since the positions xref
+   (device), one max reduction over the local atoms and one MPI_Allreduce */
+
+static MMD_float Neighbor_max_displacement(Atom *atom, const MMD_float* xref)
+{
+  const int nlocal_ = atom->nlocal;
+  const MMD_float* const restrict x_ = atom->d_x;
+  const MMD_float* const restrict xref_ = xref;
+  MMD_float maxdsq = 0.0;
+
+  #pragma acc parallel loop deviceptr(x_,xref_) reduction(max:maxdsq)
+  for(int i = 0; i < nlocal_; i++) {
+    const MMD_float delx = x_[i * PAD + 0] - xref_[i * PAD + 0];
+    const MMD_float dely = x_[i * PAD + 1] - xref_[i * PAD + 1];
+    const MMD_float delz = x_[i * PAD + 2] - xref_[i * PAD + 2];
+    const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+
+    if(rsq > maxdsq) maxdsq = rsq;
+  }
+
+  double dsq = maxdsq, dsqall;
+  MPI_Allreduce(&dsq, &dsqall, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  return sqrt(dsqall);
+}
+
+/* displacement check ("neigh_modify check yes" in LAMMPS): the lists stay
+   complete as long as no atom moved more than half the skin since the last
+   build
+   with outer lists it guards the outer list and its ghost shell, so the
+   skin is the outer one (cutneigh - cutinner) */
+
+int Neighbor_check_distance(Neighbor *neighbor, Atom *atom)
+{
+  const MMD_float skin = neighbor->outer ? neighbor->cutneigh - neighbor->cutinner : neighbor->skin;
+  const int flag = Neighbor_max_displacement(atom, atom->d_xold) > 0.5 * skin;
+
+  if(!flag) neighbor->nskip++;
+
+  return flag;
+}
+
+/* ghosts of the last full rebuild for Neighbor_update: a pair within the force
+   cutoff whose atoms both moved less than skin/2 was within cutneigh then, so
+   its ghost was sent; an atom that moved more than skin/2 can only bring in a
+   pair with a missing ghost from within cutneigh of its sub-domain boundary
+   (or from outside its sub-domain), 1 if there is such an atom on any rank
+   with background builds the trigger is the extra skin, the skin itself is
+   left for the interval the lists are used for (as in Neighbor_async_check) */
+
+int Neighbor_check_ghosts(Neighbor *neighbor, Atom *atom)
+{
+  const int nlocal_ = atom->nlocal;
+  const MMD_float* const restrict x_ = atom->d_x;
+  const MMD_float* const restrict xold_ = atom->d_xold;
+  const MMD_float skin = neighbor->async_build ? neighbor->async_skin : neighbor->skin;
+  const MMD_float triggersq = 0.25 * skin * skin;
+  const MMD_float cut = neighbor->cutneigh;
+  const MMD_float xlo = atom->box.xlo + cut, xhi = atom->box.xhi - cut;
+  const MMD_float ylo = atom->box.ylo + cut, yhi = atom->box.yhi - cut;
+  const MMD_float zlo = atom->box.zlo + cut, zhi = atom->box.zhi - cut;
+  int flag = 0;
+
+  #pragma acc parallel loop deviceptr(x_,xold_) reduction(max:flag)
+  for(int i = 0; i < nlocal_; i++) {
+    const MMD_float xtmp = x_[i * PAD + 0];
+    const MMD_float ytmp = x_[i * PAD + 1];
+    const MMD_float ztmp = x_[i * PAD + 2];
+    const MMD_float delx = xtmp - xold_[i * PAD + 0];
+    const MMD_float dely = ytmp - xold_[i * PAD + 1];
+    const MMD_float delz = ztmp - xold_[i * PAD + 2];
+    const int inside = xtmp >= xlo && xtmp <= xhi && ytmp >= ylo && ytmp <= yhi && ztmp >= zlo && ztmp <= zhi;
+
+    if(!inside && delx * delx + dely * dely + delz * delz > triggersq) flag = 1;
+  }
+
+  int flagall;
+  MPI_Allreduce(&flag, &flagall, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+  return flagall;
+}
+
+/* the lists of the helper thread come from the positions one interval
+   earlier with async_skin on top of the skin: they hold every pair a build
+   now would list as long as no atom moved more than async_skin/2 since the
+   snapshot (the displacement check against the snapshot) and the ghosts of
+   the last full rebuild are complete (Neighbor_check_ghosts); 1 if there are
+   none or a check fails, they are dropped and the integrator does a full
+   rebuild */
+
+int Neighbor_async_check(Neighbor *neighbor, Atom *atom)
+{
+  NeighborAsync* const async = neighbor->async;
+
+  if(async == NULL || !async->ready) return 1;
+
+  const MMD_float disp = Neighbor_max_displacement(atom, async->xsnap);
+
+  neighbor->async_disp = MAX(neighbor->async_disp, disp);
+
+  if(disp <= 0.5 * neighbor->async_skin && !Neighbor_check_ghosts(neighbor, atom)) return 0;
+
+  Neighbor_async_finish(neighbor, atom, 0);
+  neighbor->ndropped++;
 
-void Neighbor_init(Neighbor *n)
-{
-  n->ncalls = 0;
-  n->max_totalneigh = 0;
-  n->d_numneigh = n->numneigh = NULL;
-  n->d_neighbors = n->neighbors = NULL;
-  n->maxneighs = 100;
-  n->nmax = 0;
-  n->bincount = NULL;
-  n->bins = NULL;
-  n->atoms_per_bin = 8;
-  n->stencil = NULL;
-  n->threads = NULL;
-  n->halfneigh = 0;
-  n->ghost_newton = 1;
+  return 1;
 }
 
-void Neighbor_destroy(Neighbor *n)
+/* extra skin of the background lists: twice the largest displacement over
+   one interval times ASYNC_MARGIN, measured against the last build at the
+   first full rebuild and against the snapshots after that; it only grows,
+   1 if it did (cutneigh and skin grew with it, the caller sets up the
+   communication and the bins again before the full rebuild) */
+
+int Neighbor_async_resize(Neighbor *neighbor, Atom *atom)
 {
-#ifdef ALIGNMALLOC
-  if(n->numneigh) _mm_free(n->numneigh);
-  if(n->neighbors) _mm_free(n->neighbors);
-#else 
-  if(n->numneigh) free(n->numneigh);
-  if(n->neighbors) free(n->neighbors);
-  acc_free(n->d_numneigh);
-  acc_free(n->d_neighbors);
-#endif
-  
-  if(n->bincount) free(n->bincount);
+  if(neighbor->async_skin == 0.0)
+    neighbor->async_disp = MAX(neighbor->async_disp, Neighbor_max_displacement(atom, atom->d_xold));
 
-  if(n->bins) free(n->bins);
+  const MMD_float skin = 2.0 * ASYNC_MARGIN * neighbor->async_disp;
+
+  if(skin <= neighbor->async_skin) return 0;
+
+  // the helper thread shares the stencil, Neighbor_setup replaces it
+
+  Neighbor_async_finish(neighbor, atom, 0);
+
+  neighbor->cutneigh += skin - neighbor->async_skin;
+  neighbor->skin += skin - neighbor->async_skin;
+  neighbor->async_skin = skin;
+
+  return 1;
 }
 
-/* binned neighbor list construction with full Newton's 3rd law
-   every pair stored exactly once by some processor
-   each owned atom i checks its own bin and other bins in Newton stencil */
+/* offsets of the lists from the counts of the first build pass (exclusive
+   scan of the padded counts), the neighbors array only grows (by 20%) */
 
-void Neighbor_build(Neighbor *neighbor, Atom *atom)
+void Neighbor_offsets(Neighbor *neighbor, Atom *atom, int pad)
 {
-  neighbor->ncalls++;
   const int nlocal = atom->nlocal;
-  const int nall = atom->nlocal + atom->nghost;
-  /* extend atom arrays if necessary */
+  const int* const numneigh = neighbor->numneigh;
+  int* const firstneigh = neighbor->firstneigh;
+  int size = 0;
+  int maxneighs = 0;
 
-  
+  Atom_sync_host(atom, neighbor->numneigh, neighbor->d_numneigh, nlocal * sizeof(int));
 
-  if(nall > neighbor->nmax) {
-    neighbor->nmax = nall;
-#ifdef ALIGNMALLOC
-    if(numneigh) _mm_free(numneigh);
-    numneigh = (int*) _mm_malloc(neighbor->nmax * sizeof(int) + ALIGNMALLOC, ALIGNMALLOC);
-    if(neighbors) _mm_free(neighbors);	
-    neighbors = (int*) _mm_malloc(neighbor->nmax * maxneighs * sizeof(int*) + ALIGNMALLOC, ALIGNMALLOC);	
+  for(int i = 0; i < nlocal; i++) {
+    const int n = (numneigh[i] + pad - 1) / pad * pad;
+
+    firstneigh[i] = size;
+    size += n;
+
+    if(n > maxneighs) maxneighs = n;
+  }
+
+  firstneigh[nlocal] = size;
+  neighbor->maxneighs = maxneighs;
+
+#ifdef USELAYOUTLEFT
+  size = neighbor->nmax * maxneighs;
 #else
+  Atom_sync_device(atom, neighbor->d_firstneigh, firstneigh, (nlocal + 1) * sizeof(int));
+#endif
+
+  neighbor->totalneigh = size;
+
+  if(size > neighbor->max_totalneigh) {
+    neighbor->max_totalneigh = size * 1.2;
 
-    if(neighbor->numneigh) free(neighbor->numneigh);
     if(neighbor->neighbors) free(neighbor->neighbors);
-    acc_free(neighbor->d_numneigh);
-    acc_free(neighbor->d_neighbors);   
+    acc_free(neighbor->d_neighbors);
 
-    neighbor->numneigh = (int*) malloc(neighbor->nmax * sizeof(int));
-    neighbor->neighbors = (int*) malloc(neighbor->nmax * neighbor->maxneighs * sizeof(int*));
-    neighbor->d_numneigh = (int*) acc_malloc(neighbor->nmax * sizeof(int));
-    neighbor->d_neighbors = (int*) acc_malloc(neighbor->nmax * neighbor->maxneighs * sizeof(int*));
-#endif
+    neighbor->neighbors = (int*) malloc(neighbor->max_totalneigh * sizeof(int));
+    neighbor->d_neighbors = (int*) acc_malloc(neighbor->max_totalneigh * sizeof(int));
   }
+}
 
-  int omp_me = 0 ;//omp_get_thread_num();
-  int num_omp_threads = 1;//threads->omp_num_threads;
-  int master = -1;
+/* cluster pair lists for the CLUSTER_M x cluster_n intrinsics kernels
+   the atoms of each bin column, sorted by z, are chunked into i-clusters
+   of CLUSTER_M atoms, local atoms of all columns first, then the ghosts;
+   each column is padded to whole j-clusters of cluster_n atoms so that a
+   j-cluster is one aligned SIMD vector per coordinate in cluster_x
+   an i-cluster lists every j-cluster whose bounding box comes within
+   cutneigh of its own (its own j-cluster included); i == j, padding slots
+   and pairs beyond the cutoff drop out of the kernel masks
+   numneigh[i] is set to the # of pair slots computed for i (statistics) */
+
+static inline MMD_float Neighbor_bbox_distsq(const MMD_float* a, const MMD_float* b)
+{
+  MMD_float rsq = 0.0;
 
-  
-  master = omp_me;
+  for(int d = 0; d < 3; d++) {
+    MMD_float del = b[d] - a[d + 3];
 
-  
-  /* bin local & ghost atoms */
-  Neighbor_binatoms(neighbor, atom, -1);
-  neighbor->count = 0;
-  /* loop over each atom, storing neighbors */
+    if(a[d] - b[d + 3] > del) del = a[d] - b[d + 3];
 
+    if(del > 0.0) rsq += del * del;
+  }
 
-  int resize[1];
-  resize[0] = 1;
-  MMD_float* const restrict x_ = atom->d_x;
-  Atom_sync_device(atom, x_, &atom->x[0][0], atom->nmax*PAD*sizeof(MMD_float));
-  
+  return rsq;
+}
 
-  while(resize[0]) {
-    
-    int new_maxneighs = neighbor->maxneighs;
-    resize[0] = 0;
-    
+void Neighbor_build_clusters(Neighbor *neighbor, Atom *atom)
+{
+  const int nlocal = atom->nlocal;
+  const int mbinx = neighbor->mbinx;
+  const int mbiny = neighbor->mbiny;
+  const int ncolumns = mbinx * mbiny;
+  const int cn = neighbor->cluster_n;
+  const int cpj = cn / CLUSTER_M;
 
-    int* const restrict neighbors_ = neighbor->d_neighbors;
-    int* const restrict numneigh_ = neighbor->d_numneigh;
-    const int* const restrict bins_ = neighbor->bins;
-    const int* const restrict bincount_ = neighbor->bincount;
-    const int* const restrict stencil_ = neighbor->stencil;
-    const int nlocal_ = nlocal;
-    const int nmax_ = neighbor->nmax;
-    const int maxneighs_ = neighbor->maxneighs;
-    const MMD_float xprd_ = neighbor->xprd;
-    const MMD_float yprd_ = neighbor->yprd;
-    const MMD_float zprd_ = neighbor->zprd;
-    const int nbinx_ = neighbor->nbinx;
-    const int nbiny_ = neighbor->nbiny;
-    const int nbinz_ = neighbor->nbinz;
-    const int mbinx_ = neighbor->mbinx;
-    const int mbiny_ = neighbor->mbiny;
-    const int mbinz_ = neighbor->mbinz;
-    const MMD_float mbinxlo_ = neighbor->mbinxlo;
-    const MMD_float mbinylo_ = neighbor->mbinylo;
-    const MMD_float mbinzlo_ = neighbor->mbinzlo;
-    const MMD_float bininvx_ = neighbor->bininvx;
-    const MMD_float bininvy_ = neighbor->bininvy;
-    const MMD_float bininvz_ = neighbor->bininvz;
-    const int nstencil_ = neighbor->nstencil; 
-    const int mbins_ = neighbor->mbins;
-    const int atoms_per_bin_ = neighbor->atoms_per_bin;
-    const int halfneigh_ = neighbor->halfneigh;
-    const int ghost_newton_ = neighbor->ghost_newton;
-    const MMD_float cutneighsq_ = neighbor->cutneighsq;
+  if(2 * ncolumns + 1 > neighbor->max_columns) {
+    if(neighbor->column_start) free(neighbor->column_start);
 
-    #pragma acc kernels deviceptr(x_,numneigh_,neighbors_) copyin(bins_[0:mbins_*atoms_per_bin_],bincount_[0:mbins_],stencil_[0:nstencil_]) copy(resize[0:1])
-    for(int i = 0; i < nlocal_; i++) {
-      int* const restrict neighptr = &neighbors_[i * DS0(nmax_,maxneighs_)];
-      //int* neighptr = &neighbors[i * maxneighs];
-      /* if necessary, goto next page and add pages */
+    neighbor->max_columns = 2 * ncolumns + 1;
+    neighbor->column_start = (int*) malloc(neighbor->max_columns * sizeof(int));
+  }
+
+  int* const column_start = neighbor->column_start;
+
+  // count i-clusters per column, local atoms (pass 0) before ghosts (pass 1)
+
+  int nclusters = 0;
 
+  for(int pass = 0; pass < 2; pass++)
+    for(int col = 0; col < ncolumns; col++) {
       int n = 0;
 
-      const MMD_float xtmp = x_[i * PAD + 0];
-      const MMD_float ytmp = x_[i * PAD + 1];
-      const MMD_float ztmp = x_[i * PAD + 2];
+      for(int ibin = col + 1; ibin < neighbor->mbins; ibin += ncolumns)
+        for(int m = 0; m < neighbor->bincount[ibin]; m++)
+          if((neighbor->bins[neighbor->binstart[ibin] + m] < nlocal) == (pass == 0)) n++;
 
-      /* loop over atoms in i's bin,
-      */
+      column_start[pass * ncolumns + col] = nclusters;
+      nclusters += (n + cn - 1) / cn * cpj;
+    }
 
-      int ibin; 
-      {
-        int ix, iy, iz;
+  column_start[2 * ncolumns] = nclusters;
+  neighbor->nclusters = nclusters;
+  neighbor->nlocal_clusters = column_start[ncolumns];
 
-        if(xtmp >= xprd_)
-          ix = (int)((xtmp - xprd_) * bininvx_) + nbinx_ - mbinxlo_;
-        else if(xtmp >= 0.0)
-          ix = (int)(xtmp * bininvx_) - mbinxlo_;
-        else
-          ix = (int)(xtmp * bininvx_) - mbinxlo_ - 1;
+  if(nclusters > neighbor->max_clusters) {
+    if(neighbor->cluster_atoms) free(neighbor->cluster_atoms);
 
-        if(ytmp >= yprd_)
-          iy = (int)((ytmp - yprd_) * bininvy_) + nbiny_ - mbinylo_;
-        else if(ytmp >= 0.0)
-          iy = (int)(ytmp * bininvy_) - mbinylo_;
-        else
-          iy = (int)(ytmp * bininvy_) - mbinylo_ - 1;
+    if(neighbor->cluster_x) free(neighbor->cluster_x);
 
-        if(ztmp >= zprd_)
-          iz = (int)((ztmp - zprd_) * bininvz_) + nbinz_ - mbinzlo_;
-        else if(ztmp >= 0.0)
-          iz = (int)(ztmp * bininvz_) - mbinzlo_;
-        else
-          iz = (int)(ztmp * bininvz_) - mbinzlo_ - 1;
-        ibin = (iz * mbiny_ * mbinx_ + iy * mbinx_ + ix + 1);
+    if(neighbor->cluster_bbox) free(neighbor->cluster_bbox);
+
+    if(neighbor->jcluster_bbox) free(neighbor->jcluster_bbox);
+
+    if(neighbor->cluster_numneigh) free(neighbor->cluster_numneigh);
+
+    if(neighbor->cluster_neighbors) free(neighbor->cluster_neighbors);
+
+    neighbor->max_clusters = ((int)(nclusters * 1.2) / cpj + 1) * cpj;
+    neighbor->cluster_atoms = (int*) malloc(neighbor->max_clusters * CLUSTER_M * sizeof(int));
+    neighbor->cluster_x = (MMD_float*) aligned_alloc(64, (neighbor->max_clusters * CLUSTER_M * 3 * sizeof(MMD_float) + 63) / 64 * 64);
+    neighbor->cluster_bbox = (MMD_float*) malloc(neighbor->max_clusters * 6 * sizeof(MMD_float));
+    neighbor->jcluster_bbox = (MMD_float*) malloc(neighbor->max_clusters / cpj * 6 * sizeof(MMD_float));
+    neighbor->cluster_numneigh = (int*) malloc(neighbor->max_clusters * sizeof(int));
+    neighbor->cluster_neighbors = (int*) malloc(neighbor->max_clusters * neighbor->max_cluster_neighs * sizeof(int));
+  }
+
+  // fill the clusters column by column, sorted by z so that consecutive
+  // atoms form compact clusters (the bins only order them bin by bin)
+
+  int* const cluster_atoms = neighbor->cluster_atoms;
+  const MMD_float* const x = &atom->x[0][0];
+
+  #pragma omp parallel for
+  for(int pc = 0; pc < 2 * ncolumns; pc++) {
+    const int pass = pc / ncolumns;
+    const int col = pc % ncolumns;
+    const int first = column_start[pc] * CLUSTER_M;
+    int k = first;
+
+    for(int ibin = col + 1; ibin < neighbor->mbins; ibin += ncolumns)
+      for(int m = 0; m < neighbor->bincount[ibin]; m++) {
+        const int i = neighbor->bins[neighbor->binstart[ibin] + m];
+
+        if((i < nlocal) == (pass == 0)) cluster_atoms[k++] = i;
       }
 
-      for(int k = 0; k < nstencil_; k++) {
-        const int jbin = ibin + stencil_[k];
+    // insertion sort, the column is already in order up to the atoms of a bin
 
-        const int* restrict loc_bin = &bins_[jbin * atoms_per_bin_];
+    for(int m = first + 1; m < k; m++) {
+      const int i = cluster_atoms[m];
+      const MMD_float z = x[i * PAD + 2];
+      int n = m;
 
-        if(ibin == jbin)
-          for(int m = 0; m < bincount_[jbin]; m++) {
-            const int j = loc_bin[m];
+      for(; n > first && x[cluster_atoms[n - 1] * PAD + 2] > z; n--)
+        cluster_atoms[n] = cluster_atoms[n - 1];
 
-            //for same bin as atom i skip j if i==j and skip atoms "below and to the left" if using halfneighborlists
-            if(((j == i) || (halfneigh_ && !ghost_newton_ && (j < i)) ||
-                (halfneigh_ && ghost_newton_ && ((j < i) || ((j >= nlocal_) &&
-                                               ((x_[j * PAD + 2] < ztmp) || (x_[j * PAD + 2] == ztmp && x_[j * PAD + 1] < ytmp) ||
-                                                (x_[j * PAD + 2] == ztmp && x_[j * PAD + 1]  == ytmp && x_[j * PAD + 0] < xtmp))))))) continue;
+      cluster_atoms[n] = i;
+    }
 
-            const MMD_float delx = xtmp - x_[j * PAD + 0];
-            const MMD_float dely = ytmp - x_[j * PAD + 1];
-            const MMD_float delz = ztmp - x_[j * PAD + 2];
-            const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+    while(k < column_start[pc + 1] * CLUSTER_M) cluster_atoms[k++] = -1;
+  }
 
-            if((rsq <= cutneighsq_)) {neighptr[n*DS1(nmax_,maxneighs_)] = j; n++;}
-            //if((rsq <= cutneighsq)) neighptr[n++] = j;
-          }
-        else {
-          for(int m = 0; m < bincount_[jbin]; m++) {
-            const int j = loc_bin[m];
+  Neighbor_update_clusters(neighbor, atom);
 
-            if(halfneigh_ && !ghost_newton_ && (j < i)) continue;
+  // bounding boxes of the i- and j-clusters, empty boxes for pure padding
 
-            const MMD_float delx = xtmp - x_[j * PAD + 0];
-            const MMD_float dely = ytmp - x_[j * PAD + 1];
-            const MMD_float delz = ztmp - x_[j * PAD + 2];
-            const MMD_float rsq = delx * delx + dely * dely + delz * delz;
+  const MMD_float* const cx = neighbor->cluster_x;
+  MMD_float* const bbox = neighbor->cluster_bbox;
+  MMD_float* const jbbox = neighbor->jcluster_bbox;
 
-            if((rsq <= cutneighsq_)) {neighptr[n*DS1(nmax_,maxneighs_)] = j; n++;}
-            //if((rsq <= cutneighsq)) neighptr[n++] = j;
-          }
+  #pragma omp parallel for
+  for(int jc = 0; jc < nclusters / cpj; jc++) {
+    for(int d = 0; d < 3; d++) {
+      jbbox[jc * 6 + d] = 1.0e30;
+      jbbox[jc * 6 + d + 3] = -1.0e30;
+    }
+
+    for(int ic = jc * cpj; ic < (jc + 1) * cpj; ic++) {
+      for(int d = 0; d < 3; d++) {
+        bbox[ic * 6 + d] = 1.0e30;
+        bbox[ic * 6 + d + 3] = -1.0e30;
+      }
+
+      for(int m = 0; m < CLUSTER_M; m++) {
+        if(cluster_atoms[ic * CLUSTER_M + m] < 0) continue;
+
+        for(int d = 0; d < 3; d++) {
+          const MMD_float xd = cx[jc * 3 * cn + d * cn + (ic - jc * cpj) * CLUSTER_M + m];
+
+          if(xd < bbox[ic * 6 + d]) bbox[ic * 6 + d] = xd;
+
+          if(xd > bbox[ic * 6 + d + 3]) bbox[ic * 6 + d + 3] = xd;
         }
       }
-      numneigh_[i] = n;
 
-      if(n >= maxneighs_) {
-        resize[0] = 1;
+      for(int d = 0; d < 3; d++) {
+        if(bbox[ic * 6 + d] < jbbox[jc * 6 + d]) jbbox[jc * 6 + d] = bbox[ic * 6 + d];
 
-        if(n >= new_maxneighs) new_maxneighs = n;
+        if(bbox[ic * 6 + d + 3] > jbbox[jc * 6 + d + 3]) jbbox[jc * 6 + d + 3] = bbox[ic * 6 + d + 3];
       }
     }
+  }
 
-    // 
-
-    if(resize[0]) {
-      
-      {
-        neighbor->maxneighs = new_maxneighs * 1.2;
-#ifdef ALIGNMALLOC
-  		_mm_free(neighbors);
-  		neighbors = (int*) _mm_malloc(nmax* maxneighs * sizeof(int) + ALIGNMALLOC, ALIGNMALLOC);
-#else
-        free(neighbor->neighbors);
-        neighbor->neighbors = (int*) malloc(neighbor->nmax* neighbor->maxneighs * sizeof(int));
-        acc_free(neighbor->d_neighbors);
-        neighbor->d_neighbors = (int*) acc_malloc(neighbor->nmax* neighbor->maxneighs * sizeof(int));
-#endif
+  // j-clusters of each local i-cluster from the surrounding columns
+
+  const int nextx = (int)(neighbor->cutneigh * neighbor->bininvx) + 1;
+  const int nexty = (int)(neighbor->cutneigh * neighbor->bininvy) + 1;
+  const MMD_float cutneighsq = neighbor->cutneighsq;
+  int resize = 1;
+
+  while(resize) {
+    const int maxneighs = neighbor->max_cluster_neighs;
+    int* const cluster_numneigh = neighbor->cluster_numneigh;
+    int* const cluster_neighbors = neighbor->cluster_neighbors;
+    int new_maxneighs = maxneighs;
+    resize = 0;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int col = 0; col < ncolumns; col++) {
+      const int ix = col % mbinx;
+      const int iy = col / mbinx;
+      const int jxlo = ix - nextx > 0 ? ix - nextx : 0;
+      const int jxhi = ix + nextx < mbinx - 1 ? ix + nextx : mbinx - 1;
+      const int jylo = iy - nexty > 0 ? iy - nexty : 0;
+      const int jyhi = iy + nexty < mbiny - 1 ? iy + nexty : mbiny - 1;
+
+      for(int ic = column_start[col]; ic < column_start[col + 1]; ic++) {
+        int* const neighptr = &cluster_neighbors[ic * maxneighs];
+        int n = 0;
+
+        if(cluster_atoms[ic * CLUSTER_M] >= 0)
+          for(int jy = jylo; jy <= jyhi; jy++)
+            for(int jx = jxlo; jx <= jxhi; jx++)
+              for(int pass = 0; pass < 2; pass++) {
+                const int jcol = pass * ncolumns + jy * mbinx + jx;
+
+                for(int jc = column_start[jcol] / cpj; jc < column_start[jcol + 1] / cpj; jc++)
+                  if(Neighbor_bbox_distsq(&bbox[ic * 6], &jbbox[jc * 6]) <= cutneighsq) {
+                    if(n < maxneighs) neighptr[n] = jc;
+
+                    n++;
+                  }
+              }
+
+        cluster_numneigh[ic] = n;
       }
-      
+    }
+
+    for(int ic = 0; ic < neighbor->nlocal_clusters; ic++)
+      if(cluster_numneigh[ic] > new_maxneighs) new_maxneighs = cluster_numneigh[ic];
+
+    if(new_maxneighs > maxneighs) {
+      resize = 1;
+      neighbor->max_cluster_neighs = new_maxneighs * 1.2;
+      free(neighbor->cluster_neighbors);
+      neighbor->cluster_neighbors = (int*) malloc(neighbor->max_clusters * neighbor->max_cluster_neighs * sizeof(int));
     }
   }
+
+  for(int ic = 0; ic < neighbor->nlocal_clusters; ic++)
+    for(int m = 0; m < CLUSTER_M; m++) {
+      const int i = cluster_atoms[ic * CLUSTER_M + m];
+
+      if(i >= 0) neighbor->numneigh[i] = neighbor->cluster_numneigh[ic] * cn;
+    }
 }
 
-void Neighbor_binatoms(Neighbor *neighbor, Atom *atom, int count)
+/* positions of the last build's atoms into the j-cluster vectors, the
+   padding slots go to CLUSTER_DUMMY; called by the cluster kernels every step */
+
+void Neighbor_update_clusters(Neighbor *neighbor, Atom *atom)
 {
-  
-  const int omp_me = omp_get_thread_num();
-  const int num_omp_threads = neighbor->threads->omp_num_threads;
+  const int cn = neighbor->cluster_n;
+  const int cpj = cn / CLUSTER_M;
+  const int* const cluster_atoms = neighbor->cluster_atoms;
+  const MMD_float* const x = &atom->x[0][0];
+  MMD_float* const cx = neighbor->cluster_x;
+
+  #pragma omp parallel for
+  for(int ic = 0; ic < neighbor->nclusters; ic++) {
+    MMD_float* const cxi = &cx[(ic / cpj) * 3 * cn + (ic % cpj) * CLUSTER_M];
+
+    for(int m = 0; m < CLUSTER_M; m++) {
+      const int i = cluster_atoms[ic * CLUSTER_M + m];
+
+      for(int d = 0; d < 3; d++)
+        cxi[d * cn + m] = i < 0 ? CLUSTER_DUMMY : x[i * PAD + d];
+    }
+  }
+}
+
+/* group the bins of the last build into blocks of colorblockx/y/z bins and
+   color the blocks with 8 colors by the parity of their block coordinates
+   a block writes forces only to bins within the stencil reach of its own bins,
+   the block width is at least that reach, so two distinct blocks of the same
+   color (2 or more blocks apart in at least one dimension) never touch the
+   same atom: threads can process all blocks of one color without locks */
 
+void Neighbor_build_colors(Neighbor *neighbor, Atom *atom)
+{
   const int nlocal = atom->nlocal;
+  const int mbinx = neighbor->mbinx;
+  const int mbiny = neighbor->mbiny;
+  const int mbinz = neighbor->mbinz;
+  const int wx = neighbor->colorblockx;
+  const int wy = neighbor->colorblocky;
+  const int wz = neighbor->colorblockz;
+  const int nbx = (mbinx + wx - 1) / wx;
+  const int nby = (mbiny + wy - 1) / wy;
+  const int nbz = (mbinz + wz - 1) / wz;
+  const int nblocks = nbx * nby * nbz;
+
+  if(nblocks + 1 > neighbor->max_blocks) {
+    if(neighbor->block_start) free(neighbor->block_start);
+
+    if(neighbor->block_pos) free(neighbor->block_pos);
+
+    neighbor->max_blocks = nblocks + 1;
+    neighbor->block_start = (int*) malloc(neighbor->max_blocks * sizeof(int));
+    neighbor->block_pos = (int*) malloc(neighbor->max_blocks * sizeof(int));
+  }
+
+  if(nlocal > neighbor->max_block_atoms) {
+    if(neighbor->block_atoms) free(neighbor->block_atoms);
+
+    neighbor->max_block_atoms = nlocal;
+    neighbor->block_atoms = (int*) malloc(neighbor->max_block_atoms * sizeof(int));
+  }
+
+  int* const block_start = neighbor->block_start;
+  int* const block_atoms = neighbor->block_atoms;
+  int* const block_pos = neighbor->block_pos;
+
+  // position of every block in color major order
+
+  int p = 0;
+
+  for(int c = 0; c < 8; c++) {
+    neighbor->color_start[c] = p;
+
+    for(int bz = (c >> 2) & 1; bz < nbz; bz += 2)
+      for(int by = (c >> 1) & 1; by < nby; by += 2)
+        for(int bx = c & 1; bx < nbx; bx += 2)
+          block_pos[(bz * nby + by) * nbx + bx] = p++;
+  }
+
+  neighbor->color_start[8] = p;
+  neighbor->nblocks = nblocks;
+
+  /* count local atoms per block, prefix sum, then fill
+     bin numbering is iz*mbiny*mbinx + iy*mbinx + ix + 1 (see coord2bin),
+     so bin 0 never holds atoms */
+
+  for(int b = 0; b <= nblocks; b++) block_start[b] = 0;
+
+  for(int ibin = 1; ibin < neighbor->mbins; ibin++) {
+    const int* const loc_bin = &neighbor->bins[neighbor->binstart[ibin]];
+    int n = 0;
+
+    for(int m = 0; m < neighbor->bincount[ibin]; m++)
+      if(loc_bin[m] < nlocal) n++;
+
+    if(n == 0) continue;
+
+    const int ix = (ibin - 1) % mbinx;
+    const int iy = ((ibin - 1) / mbinx) % mbiny;
+    const int iz = (ibin - 1) / (mbinx * mbiny);
+    block_start[block_pos[((iz / wz) * nby + iy / wy) * nbx + ix / wx] + 1] += n;
+  }
+
+  for(int b = 0; b < nblocks; b++) block_start[b + 1] += block_start[b];
+
+  for(int ibin = 1; ibin < neighbor->mbins; ibin++) {
+    const int* const loc_bin = &neighbor->bins[neighbor->binstart[ibin]];
+
+    if(neighbor->bincount[ibin] == 0) continue;
+
+    const int ix = (ibin - 1) % mbinx;
+    const int iy = ((ibin - 1) / mbinx) % mbiny;
+    const int iz = (ibin - 1) / (mbinx * mbiny);
+    const int b = block_pos[((iz / wz) * nby + iy / wy) * nbx + ix / wx];
+
+    for(int m = 0; m < neighbor->bincount[ibin]; m++)
+      if(loc_bin[m] < nlocal) block_atoms[block_start[b]++] = loc_bin[m];
+  }
+
+  // fill pass advanced every block_start by its size, shift back
+
+  for(int b = nblocks; b > 0; b--) block_start[b] = block_start[b - 1];
+
+  block_start[0] = 0;
+}
+
+/* counting sort of the first count atoms (all atoms if count < 0) into bins:
+   each thread histograms a static chunk of the atoms, the scan over
+   (bin, thread) gives every thread its write position in every bin and the
+   scatter over the same chunks keeps the atoms of a bin in index order
+   atoms of bin ibin are bins[binstart[ibin]] ... bins[binstart[ibin + 1] - 1] */
+
+void Neighbor_binatoms(Neighbor *neighbor, Atom *atom, int count)
+{
+  const int num_omp_threads = neighbor->threads->omp_num_threads;
   const int nall = count < 0 ? atom->nlocal + atom->nghost:count;
+  const int mbins = neighbor->mbins;
   const MMD_float* x = &atom->x[0][0];
 
   neighbor->xprd = atom->box.xprd;
   neighbor->yprd = atom->box.yprd;
   neighbor->zprd = atom->box.zprd;
 
-  neighbor->resize = 1; 
+  if(nall > neighbor->max_bins) {
+    if(neighbor->bins) free(neighbor->bins);
+
+    if(neighbor->atombin) free(neighbor->atombin);
+
+    neighbor->max_bins = nall * 1.2;
+    neighbor->bins = (int*) malloc(neighbor->max_bins * sizeof(int));
+    neighbor->atombin = (int*) malloc(neighbor->max_bins * sizeof(int));
+  }
+
+  int* const restrict bins = neighbor->bins;
+  int* const restrict atombin = neighbor->atombin;
+  int* const restrict bincount = neighbor->bincount;
+  int* const restrict binstart = neighbor->binstart;
+  int* const restrict binhist = neighbor->binhist;
+  MMD_float* const restrict binbox = neighbor->binbox;
 
-  while(neighbor->resize > 0) {
-    
-    neighbor->resize = 0;
-    
-    
-    for(int i = 0; i < neighbor->mbins; i++) neighbor->bincount[i] = 0;
+  #pragma omp parallel num_threads(num_omp_threads)
+  {
+    int* const restrict hist = &binhist[omp_get_thread_num() * mbins];
+    const int nthreads = omp_get_num_threads();
 
+    for(int ibin = 0; ibin < mbins; ibin++) hist[ibin] = 0;
 
-    #pragma omp parallel for 
+    #pragma omp for schedule(static)
     for(int i = 0; i < nall; i++) {
       const int ibin = Neighbor_coord2bin(neighbor, x[i * PAD + 0], x[i * PAD + 1], x[i * PAD + 2]);
-      //printf("%i %i %lf %lf %lf\n",i,ibin,x[i * PAD + 0], x[i * PAD + 1], x[i * PAD + 2]);
-      if(neighbor->bincount[ibin] < neighbor->atoms_per_bin) {
-        int ac;
-#ifdef OpenMP31
-        ac = neighbor->bincount[ibin]++;
-#else
-        ac = __sync_fetch_and_add(neighbor->bincount + ibin, 1);
-#endif
-        neighbor->bins[ibin * neighbor->atoms_per_bin + ac] = i;
-      } else neighbor->resize = 1;
+      atombin[i] = ibin;
+      hist[ibin]++;
     }
 
-    // 
+    #pragma omp for schedule(static)
+    for(int ibin = 0; ibin < mbins; ibin++) {
+      int n = 0;
 
-    
+      for(int t = 0; t < nthreads; t++) n += binhist[t * mbins + ibin];
 
-    if(neighbor->resize) {
-      free(neighbor->bins);
-      neighbor->atoms_per_bin *= 2;
-      neighbor->bins = (int*) malloc(neighbor->mbins * neighbor->atoms_per_bin * sizeof(int));
+      bincount[ibin] = n;
     }
 
-    // 
-  }
+    #pragma omp single
+    {
+      binstart[0] = 0;
+
+      for(int ibin = 0; ibin < mbins; ibin++) binstart[ibin + 1] = binstart[ibin] + bincount[ibin];
+    }
 
-  
+    #pragma omp for schedule(static)
+    for(int ibin = 0; ibin < mbins; ibin++) {
+      int pos = binstart[ibin];
 
+      for(int t = 0; t < nthreads; t++) {
+        const int n = binhist[t * mbins + ibin];
+        binhist[t * mbins + ibin] = pos;
+        pos += n;
+      }
+    }
+
+    // same static schedule as the histogram loop, so every thread sees its own atoms
+
+    #pragma omp for schedule(static)
+    for(int i = 0; i < nall; i++)
+      bins[hist[atombin[i]]++] = i;
+
+    // bounding boxes for the culling in Neighbor_sweep, empty bins get an inverted box
+
+    #pragma omp for schedule(static)
+    for(int ibin = 0; ibin < mbins; ibin++) {
+      MMD_float* const box = &binbox[6 * ibin];
+
+      box[0] = box[1] = box[2] = BIG;
+      box[3] = box[4] = box[5] = -BIG;
+
+      for(int m = binstart[ibin]; m < binstart[ibin + 1]; m++) {
+        const int j = bins[m];
+
+        for(int d = 0; d < 3; d++) {
+          if(x[j * PAD + d] < box[d]) box[d] = x[j * PAD + d];
+          if(x[j * PAD + d] > box[3 + d]) box[3 + d] = x[j * PAD + d];
+        }
+      }
+    }
+  }
 }
 
 /* convert xyz atom coords into local bin #
@@ -386,6 +1936,7 @@ int Neighbor_setup(Neighbor *neighbor, Atom *atom)
   int num_omp_threads = neighbor->threads->omp_num_threads;
 
   neighbor->cutneighsq = neighbor->cutneigh * neighbor->cutneigh;
+  neighbor->cutinnersq = neighbor->cutinner * neighbor->cutinner;
 
   neighbor->xprd = atom->box.xprd;
   neighbor->yprd = atom->box.yprd;
@@ -477,15 +2028,34 @@ int Neighbor_setup(Neighbor *neighbor, Atom *atom)
 
   nmax = (2 * nextz + 1) * (2 * nexty + 1) * (2 * nextx + 1);
 
+  /* width of the colored bin blocks = extent of the stencil per dimension
+     (the half stencil with ghost_newton only reaches up in z) */
+
+  neighbor->colorblockx = 2 * nextx;
+  neighbor->colorblocky = 2 * nexty;
+  neighbor->colorblockz = (neighbor->halfneigh && neighbor->ghost_newton) ? nextz : 2 * nextz;
+
+  if(neighbor->colorblockx < 1) neighbor->colorblockx = 1;
+
+  if(neighbor->colorblocky < 1) neighbor->colorblocky = 1;
+
+  if(neighbor->colorblockz < 1) neighbor->colorblockz = 1;
+
   if(neighbor->stencil) free(neighbor->stencil);
 
+  if(neighbor->stencilxyz) free(neighbor->stencilxyz);
+
   neighbor->stencil = (int*) malloc(nmax * sizeof(int));
+  neighbor->stencilxyz = (int*) malloc(3 * nmax * sizeof(int));
 
   neighbor->nstencil = 0;
   int kstart = -nextz;
 
   if(neighbor->halfneigh && neighbor->ghost_newton) {
     kstart = 0;
+    neighbor->stencilxyz[3 * neighbor->nstencil + 0] = 0;
+    neighbor->stencilxyz[3 * neighbor->nstencil + 1] = 0;
+    neighbor->stencilxyz[3 * neighbor->nstencil + 2] = 0;
     neighbor->stencil[neighbor->nstencil++] = 0;
   }
 
@@ -494,6 +2064,9 @@ int Neighbor_setup(Neighbor *neighbor, Atom *atom)
       for(i = -nextx; i <= nextx; i++) {
         if(!neighbor->ghost_newton || !neighbor->halfneigh || (k > 0 || j > 0 || (j == 0 && i > 0)))
           if(Neighbor_bindist(neighbor, i, j, k) < neighbor->cutneighsq) {
+            neighbor->stencilxyz[3 * neighbor->nstencil + 0] = i;
+            neighbor->stencilxyz[3 * neighbor->nstencil + 1] = j;
+            neighbor->stencilxyz[3 * neighbor->nstencil + 2] = k;
             neighbor->stencil[neighbor->nstencil++] = k * neighbor->mbiny * neighbor->mbinx + j * neighbor->mbinx + i;
           }
       }
@@ -502,13 +2075,43 @@ int Neighbor_setup(Neighbor *neighbor, Atom *atom)
 
   neighbor->mbins = neighbor->mbinx * neighbor->mbiny * neighbor->mbinz;
 
+  // bins, stencil and ghosts cover the background lists, the ones built here
+  // only need the skin (Neighbor_async_sync_config sets the full cutoff)
+
+  if(neighbor->async_build) {
+    const MMD_float cutlist = neighbor->cutneigh - neighbor->async_skin;
+
+    neighbor->cutneighsq = cutlist * cutlist;
+  }
+
   if(neighbor->bincount) free(neighbor->bincount);
 
-  neighbor->bincount = (int*) malloc(neighbor->mbins * num_omp_threads * sizeof(int));
+  if(neighbor->binstart) free(neighbor->binstart);
+
+  if(neighbor->binhist) free(neighbor->binhist);
 
-  if(neighbor->bins) free(neighbor->bins);
+  if(neighbor->binbox) free(neighbor->binbox);
 
-  neighbor->bins = (int*) malloc(neighbor->mbins * num_omp_threads * neighbor->atoms_per_bin * sizeof(int));
+  neighbor->bincount = (int*) malloc(neighbor->mbins * sizeof(int));
+  neighbor->binstart = (int*) malloc((neighbor->mbins + 1) * sizeof(int));
+  neighbor->binhist = (int*) malloc(neighbor->mbins * num_omp_threads * sizeof(int));
+  neighbor->binbox = (MMD_float*) malloc(6 * neighbor->mbins * sizeof(MMD_float));
+
+  // cell coordinates (shifted by one) have to fit into the bits of a key
+
+  const int mbinmax = MAX(neighbor->mbinx, MAX(neighbor->mbiny, neighbor->mbinz));
+
+  if(neighbor->engine == NEIGH_MORTON && mbinmax + 2 > (1 << MORTON_BITS)) neighbor->engine = NEIGH_BINS;
+
+  if(neighbor->morton_hist) free(neighbor->morton_hist);
+
+  neighbor->morton_hist = (int*) malloc(256 * num_omp_threads * sizeof(int));
+
+  if(neighbor->incremental) {
+    if(neighbor->dirtybin) free(neighbor->dirtybin);
+
+    neighbor->dirtybin = (int*) malloc(neighbor->mbins * sizeof(int));
+  }
   return 0;
 }
 
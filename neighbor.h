@@ -36,21 +36,68 @@
 #include "threadData.h"
 #include "timer.h"
 
+#define CLUSTER_M 4                  // atoms per i-cluster
+#define CLUSTER_DUMMY 1.0e5          // coordinate of the padding slots, far outside any cutoff
+
+#define NEIGH_BINS 0                 // list engines: binned stencil sweep
+#define NEIGH_MORTON 1               // sorted Morton keys of the cells, see Neighbor_build_morton
+#define MORTON_BITS 10               // bits per dimension of a cell key
+
 typedef struct Neighbor_s
 {
-    int every;                       // re-neighbor every this often
+    int every;                       // re-neighbor (or check) every this often
+    int check;                       // only re-neighbor if some atom moved more than skin/2
+    MMD_float skin;                  // cutneigh - force cutoff
+    int nskip;                       // # of checks that did not trigger a build
+    int ndanger;                     // check = 2 (autotune trials): builds after some atom moved more than skin/2
+    int outer;                       // 1: cutneigh is the cutoff of an outer list, see Neighbor_build_inner
+    int full_every;                  // full rebuild every this often with outer lists or updates, multiple of every
+    MMD_float cutinner, cutinnersq;  // cutoff of the lists of the force kernels with outer lists
+    int incremental;                 // 1: Neighbor_update between full rebuilds
+    int nupdated;                    // # of lists rebuilt by Neighbor_update
+    int async_build;                 // 1: build the lists between full rebuilds on a helper thread
+    int nasync;                      // # of lists taken over from the helper thread
+    MMD_float async_skin;            // extra skin of the background lists, see Neighbor_async_resize
+    MMD_float async_disp;            // largest displacement over one interval measured so far
+    int ndropped;                    // # of background lists dropped for a full rebuild
+    struct NeighborAsync_s* async;   // helper thread state (neighbor.c)
     int nbinx, nbiny, nbinz;         // # of global bins
     MMD_float cutneigh;                 // neighbor cutoff
     MMD_float cutneighsq;               // neighbor cutoff squared
     int ncalls;                      // # of times build has been called
-    int max_totalneigh;              // largest # of neighbors ever stored
+    int max_totalneigh;              // allocated size of neighbors
 
     int* numneigh;                   // # of neighbors for each atom
-    int* neighbors;                  // array of neighbors of each atom
+    int* firstneigh;                 // offset of each atom's list in neighbors (FIRSTNEIGH)
+    int* neighbors;                  // packed lists of neighbors of all atoms
     int* d_numneigh;
+    int* d_firstneigh;
     int* d_neighbors;
-    int maxneighs;				   // max number of neighbors per atom
+    int totalneigh;                  // # of entries in neighbors (incl. padding)
+    int maxneighs;                   // longest (padded) list, row length with USELAYOUTLEFT
+    int* outer_numneigh;             // outer list, same layout as the lists above
+    int* outer_firstneigh;
+    int* outer_neighbors;
+    int* d_outer_numneigh;
+    int* d_outer_firstneigh;
+    int* d_outer_neighbors;
+    int outer_totalneigh, outer_maxneighs, max_outer_totalneigh;
+    int* rebuild;                    // Neighbor_update: 1 for atoms that get a new list
+    int* d_rebuild;
+    int* buildbin;                   // bin of each atom at the last Neighbor_build
+    int* dirtybin;                   // bins an atom entered or left (or moved too far in)
+    int* prev_firstneigh;            // lists before the update, copied for the other atoms
+    int* d_prev_firstneigh;
+    int* prev_neighbors;
+    int* d_prev_neighbors;
+    int max_prev_totalneigh;
     int halfneigh;
+    int hostlist;                    // keep a host copy of the lists for the host force kernels
+    int* ilist;                      // local atoms, interior ones (lists without ghosts) first
+    int* d_ilist;
+    int* iflag;                      // 1 if the list of the atom holds ghosts
+    int ninterior;                   // # of interior atoms at the front of ilist
+    int max_ilist;
 
     MMD_int ghost_newton;
     int count;
@@ -60,10 +107,14 @@ typedef struct Neighbor_s
     ThreadData* threads;
 
 
-    int* bincount;                    // ptr to 1st atom in each bin
-    int* bins;                       // ptr to next atom in each bin
+    int* bincount;                   // # of atoms in each bin
+    int* binstart;                   // offset of each bin in bins (mbins + 1)
+    int* binhist;                    // per thread bin histograms / write positions
+    MMD_float* binbox;               // extent of the atoms in each bin (lo xyz, hi xyz)
+    int* bins;                       // atoms ordered by bin (counting sort)
+    int* atombin;                    // bin of each atom
+    int max_bins;                    // allocated size of bins and atombin
     int mbins;                       // binning parameters
-    int atoms_per_bin;
     int nmax;                        // max size of atom arrays in neighbor
 
     MMD_float xprd, yprd, zprd;         // box size
@@ -71,13 +122,54 @@ typedef struct Neighbor_s
 
     int nstencil;                    // # of bins in stencil
     int* stencil;                    // stencil list of bin offsets
+    int* stencilxyz;                 // the same offsets as dx, dy, dz
+
+    // Morton-key list engine: cell keys of all atoms, sorted with the atoms
+
+    int engine;                      // NEIGH_BINS or NEIGH_MORTON
+    unsigned int* morton_key;        // sorted keys (then tmp buffers of the radix sort)
+    unsigned int* morton_tmpkey;
+    int* morton_atoms;               // atoms in key order
+    int* morton_tmpatoms;
+    unsigned int* morton_cellkey;    // key of each occupied cell
+    int* morton_cellstart;           // first sorted atom of each occupied cell (ncells + 1)
+    int* morton_hist;                // per thread digit histograms
+    int max_morton;
 
     int mbinx, mbiny, mbinz;
     int mbinxlo, mbinylo, mbinzlo;
     MMD_float binsizex, binsizey, binsizez;
     MMD_float bininvx, bininvy, bininvz;
 
-    int resize;
+    // 8-color (2x2x2) blocks of bins for the conflict free threaded half
+    // neighborlist force: blocks of one color never update the same f[j]
+
+    int bincolor;                    // build colored blocks in Neighbor_build
+    int colorblockx, colorblocky, colorblockz; // block width in bins
+    int color_start[9];              // first block of each color
+    int nblocks;
+    int* block_start;                // first entry of each block in block_atoms
+    int* block_atoms;                // local atoms ordered by color and block
+    int* block_pos;                  // position of each block in color major order
+    int max_blocks, max_block_atoms;
+
+    // cluster pair lists for the intrinsics kernels (see Neighbor_build_clusters):
+    // i-clusters of CLUSTER_M atoms, cluster_n / CLUSTER_M consecutive i-clusters
+    // form a j-cluster of one SIMD vector, lists hold j-clusters per i-cluster
+
+    int clusterlist;                 // build cluster pair lists instead of atom lists
+    int cluster_n;                   // atoms per j-cluster (SIMD width)
+    int nclusters;                   // # of i-clusters (incl. padding)
+    int nlocal_clusters;             // i-clusters of local atoms come first
+    int* column_start;               // first i-cluster of each bin column, locals then ghosts
+    int* cluster_atoms;              // atom in each i-cluster slot, -1 for padding
+    MMD_float* cluster_x;            // x, y, z vectors of each j-cluster
+    MMD_float* cluster_bbox;         // bounding box of each i-cluster (lo xyz, hi xyz)
+    MMD_float* jcluster_bbox;        // bounding box of each j-cluster
+    int* cluster_numneigh;           // # of j-clusters of each local i-cluster
+    int* cluster_neighbors;          // j-clusters of each local i-cluster
+    int max_cluster_neighs;
+    int max_clusters, max_columns;
 
 }Neighbor;
 
@@ -85,11 +177,25 @@ void Neighbor_init(Neighbor *);
 void Neighbor_destroy(Neighbor *);
 int Neighbor_setup(Neighbor *, Atom *);               // setup bins based on box and cutoff
 void Neighbor_build(Neighbor *, Atom *);              // create neighbor list
+void Neighbor_offsets(Neighbor *, Atom *, int pad);   // list offsets from the counts of the first build pass
+void Neighbor_build_inner(Neighbor *, Atom *);        // filter the outer list down to cutinner
+void Neighbor_update(Neighbor *, Atom *);             // rebuild the lists near atoms that changed bin
+void Neighbor_async_start(Neighbor *, Atom *);        // build the next lists from a snapshot in the background
+void Neighbor_async_finish(Neighbor *, Atom *, int swap); // wait for it and (swap) use its lists
+int Neighbor_async_check(Neighbor *, Atom *);         // 1 if the background lists cannot be used
+int Neighbor_async_resize(Neighbor *, Atom *);        // 1 if the extra skin grew (setup again)
+int Neighbor_check_distance(Neighbor *, Atom *);      // 1 if any atom (on any rank) moved more than skin/2
+int Neighbor_check_ghosts(Neighbor *, Atom *);        // 1 if the ghosts of the last full rebuild may be incomplete
+void Neighbor_split_interior(Neighbor *, Atom *);     // ilist interior atoms first (overlapped halo exchange)
 
 // Atom is going to call binatoms etc for sorting
 void Neighbor_binatoms(Neighbor *, Atom *atom, int count);           // bin all atoms
+int Neighbor_sort_morton(Neighbor *, Atom *atom, int count);         // atoms in Morton order of their bins
 
 MMD_float Neighbor_bindist(Neighbor *, int, int, int);   // distance between binx
-inline int Neighbor_coord2bin(Neighbor *, MMD_float, MMD_float, MMD_float);   // mapping atom coord to a bin
+void Neighbor_build_colors(Neighbor *, Atom *atom);    // color bin blocks of last build
+void Neighbor_build_clusters(Neighbor *, Atom *atom);  // cluster pair lists from the bins of last build
+void Neighbor_update_clusters(Neighbor *, Atom *atom); // copy current positions into the clusters
+int Neighbor_coord2bin(Neighbor *, MMD_float, MMD_float, MMD_float);   // mapping atom coord to a bin
 
 #endif
@@ -47,6 +47,10 @@ inline int omp_get_max_threads()
 {
   return 1;
 }
+inline int omp_get_num_threads()
+{
+  return 1;
+}
 inline int omp_set_num_threads(int num_threads)
 {
   return 1;
@@ -42,6 +42,7 @@
 #include "timer.h"
 #include <time.h>
 #include "variant.h"
+#include "simd.h"
 
 void stats(int, double*, double*, double*, double*, int, int*);
 
@@ -124,15 +125,29 @@ void output(In *in, Atom *atom, Force* force, Neighbor *neighbor, Comm *comm,
       fprintf(stdout, "  force_params: %2.2lf %2.2lf\n",force->epsilon,force->sigma);
       fprintf(stdout, "  neighbor_cutoff: %lf\n", neighbor->cutneigh);
       fprintf(stdout, "  neighbor_type: %i\n", neighbor->halfneigh);
+      fprintf(stdout, "  half_threading: %s\n", force->half_threading == HALFNEIGH_ATOMIC ? "atomic" : (force->half_threading == HALFNEIGH_COLOR ? "color" : "private"));
       fprintf(stdout, "  neighbor_bins: %i %i %i\n", neighbor->nbinx, neighbor->nbiny, neighbor->nbinz);
       fprintf(stdout, "  neighbor_frequency: %i\n", neighbor->every);
+      fprintf(stdout, "  neighbor_engine: %s\n", neighbor->engine == NEIGH_MORTON && !neighbor->clusterlist ? "morton" : "bins");
+      fprintf(stdout, "  neighbor_check: %i\n", neighbor->check);
+      fprintf(stdout, "  neighbor_skin: %lf\n", neighbor->skin);
+      fprintf(stdout, "  autotune_steps: %i\n", in->autotune);
+      fprintf(stdout, "  outer_list_cutoff: %lf\n", neighbor->outer ? neighbor->cutneigh : 0.0);
+      fprintf(stdout, "  incremental_update: %i\n", neighbor->incremental);
+      fprintf(stdout, "  async_neighbor_build: %i\n", neighbor->async_build);
+      fprintf(stdout, "  full_rebuild_frequency: %i\n", neighbor->full_every);
       fprintf(stdout, "  sort_frequency: %i\n", integrate->sort_every);
+      fprintf(stdout, "  ghost_sort: %i\n", comm->ghost_sort);
+      fprintf(stdout, "  halo_exchange: %s\n", comm->direct ? "direct" : "sweep");
       fprintf(stdout, "  timestep_size: %lf\n", integrate->dt);
       fprintf(stdout, "  thermo_frequency: %i\n", thermo->nstat);
       fprintf(stdout, "  ghost_newton: %i\n", neighbor->ghost_newton);
       fprintf(stdout, "  use_intrinsics: %i\n", force->use_sse);
+      fprintf(stdout, "  simd_isa: %s\n", Simd_name(force->simd));
+      fprintf(stdout, "  cluster_width: %i\n", neighbor->clusterlist ? neighbor->cluster_n : 0);
       fprintf(stdout, "  safe_exchange: %i\n", comm->do_safeexchange);
-      fprintf(stdout, "  float_size: %i\n\n", sizeof(MMD_float));
+      fprintf(stdout, "  float_size: %i\n", sizeof(MMD_float));
+      fprintf(stdout, "  pair_float_size: %i\n\n", (int) sizeof(MMD_pfloat));
     }
 
     fprintf(fp, "run_configuration: \n");
@@ -150,15 +165,29 @@ void output(In *in, Atom *atom, Force* force, Neighbor *neighbor, Comm *comm,
     fprintf(fp, "  force_params: %2.2lf %2.2lf\n",force->epsilon,force->sigma);
     fprintf(fp, "  neighbor_cutoff: %lf\n", neighbor->cutneigh);
     fprintf(fp, "  neighbor_type: %i\n", neighbor->halfneigh);
+    fprintf(fp, "  half_threading: %s\n", force->half_threading == HALFNEIGH_ATOMIC ? "atomic" : (force->half_threading == HALFNEIGH_COLOR ? "color" : "private"));
     fprintf(fp, "  neighbor_bins: %i %i %i\n", neighbor->nbinx, neighbor->nbiny, neighbor->nbinz);
     fprintf(fp, "  neighbor_frequency: %i\n", neighbor->every);
+    fprintf(fp, "  neighbor_engine: %s\n", neighbor->engine == NEIGH_MORTON && !neighbor->clusterlist ? "morton" : "bins");
+    fprintf(fp, "  neighbor_check: %i\n", neighbor->check);
+    fprintf(fp, "  neighbor_skin: %lf\n", neighbor->skin);
+    fprintf(fp, "  autotune_steps: %i\n", in->autotune);
+    fprintf(fp, "  outer_list_cutoff: %lf\n", neighbor->outer ? neighbor->cutneigh : 0.0);
+    fprintf(fp, "  incremental_update: %i\n", neighbor->incremental);
+    fprintf(fp, "  async_neighbor_build: %i\n", neighbor->async_build);
+    fprintf(fp, "  full_rebuild_frequency: %i\n", neighbor->full_every);
     fprintf(fp, "  sort_frequency: %i\n", integrate->sort_every);
+    fprintf(fp, "  ghost_sort: %i\n", comm->ghost_sort);
+    fprintf(fp, "  halo_exchange: %s\n", comm->direct ? "direct" : "sweep");
     fprintf(fp, "  timestep_size: %lf\n", integrate->dt);
     fprintf(fp, "  thermo_frequency: %i\n", thermo->nstat);
     fprintf(fp, "  ghost_newton: %i\n", neighbor->ghost_newton);
     fprintf(fp, "  use_intrinsics: %i\n", force->use_sse);
+    fprintf(fp, "  simd_isa: %s\n", Simd_name(force->simd));
+    fprintf(fp, "  cluster_width: %i\n", neighbor->clusterlist ? neighbor->cluster_n : 0);
     fprintf(fp, "  safe_exchange: %i\n", comm->do_safeexchange);
-    fprintf(fp, "  float_size: %i\n\n", sizeof(MMD_float));
+    fprintf(fp, "  float_size: %i\n", sizeof(MMD_float));
+    fprintf(fp, "  pair_float_size: %i\n\n", (int) sizeof(MMD_pfloat));
 
     if(screen_yaml)
       fprintf(stdout, "\n\nthermodynamic_output:\n");
@@ -254,8 +283,18 @@ void output(In *in, Atom *atom, Force* force, Neighbor *neighbor, Comm *comm,
     fprintf(fp,    "  comm:  %g\n", tmp);
   }
 
+  double time_sort = timer->array[TIME_SORT];
+  MPI_Allreduce(&time_sort, &tmp, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  tmp /= nprocs;
+
+  if(me == 0) {
+    if(screen_yaml)
+      fprintf(stdout, "  sort:  %g\n", tmp);
+
+    fprintf(fp,    "  sort:  %g\n", tmp);
+  }
 
-  double time_other = time_total - (time_force + time_neigh + time_comm);
+  double time_other = time_total - (time_force + time_neigh + time_comm + time_sort);
   MPI_Allreduce(&time_other, &tmp, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
   tmp /= nprocs;
 
@@ -0,0 +1,59 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+#include "simd.h"
+
+SimdIsa Simd_select(int use_sse)
+{
+  if(use_sse <= 0) return SIMD_NONE;
+
+#ifdef HAVE_SIMD_KERNELS
+  __builtin_cpu_init();
+
+  if(use_sse != 2 && __builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMD_AVX2;
+#endif
+
+  return SIMD_NONE;
+}
+
+const char* Simd_name(SimdIsa isa)
+{
+  return isa == SIMD_AVX512 ? "avx512" : (isa == SIMD_AVX2 ? "avx2" : "none");
+}
+
+int Simd_width(SimdIsa isa)
+{
+  const int bytes = isa == SIMD_AVX512 ? 64 : (isa == SIMD_AVX2 ? 32 : 0);
+
+  return bytes / (int) sizeof(MMD_float);
+}
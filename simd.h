@@ -0,0 +1,52 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "types.h"
+
+// the intrinsics kernels are built with gcc/clang/icc target attributes for x86-64,
+// the device (layout left) neighborlists are not contiguous per atom
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__PGI) && !defined(USELAYOUTLEFT)
+#define HAVE_SIMD_KERNELS
+#endif
+
+/* runtime selection of the intrinsics kernels (-sse option):
+   0 = off, 1 = best ISA supported by the CPU, 2 = AVX2, 3 = AVX-512
+   a request the CPU (or compiler) can not serve falls back to a lower ISA */
+
+SimdIsa Simd_select(int use_sse);
+const char* Simd_name(SimdIsa isa);
+int Simd_width(SimdIsa isa);           // MMD_float lanes per vector, 0 for SIMD_NONE
+
+#endif
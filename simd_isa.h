@@ -0,0 +1,226 @@
+/* ----------------------------------------------------------------------
+   miniMD is a simple, parallel molecular dynamics (MD) code.   miniMD is
+   an MD microapplication in the Mantevo project at Sandia National
+   Laboratories ( http://www.mantevo.org ). The primary
+   authors of miniMD are Steve Plimpton (sjplimp@sandia.gov) , Paul Crozier
+   (pscrozi@sandia.gov) and Christian Trott (crtrott@sandia.gov).
+
+   Copyright (2008) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This library is free software; you
+   can redistribute it and/or modify it under the terms of the GNU Lesser
+   General Public License as published by the Free Software Foundation;
+   either version 3 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this software; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+   USA.  See also: http://www.gnu.org/licenses/lgpl.txt .
+
+   For questions, contact Paul S. Crozier (pscrozi@sandia.gov) or
+   Christian Trott (crtrott@sandia.gov).
+
+   Please read the accompanying README and LICENSE files.
+---------------------------------------------------------------------- */
+
+/* vector abstraction of the intrinsics kernels; include with SIMD_ISA set to
+   avx2 or avx512 (re-including for another ISA redefines everything):
+   SIMD_TARGET, SIMD_WIDTH and
+   vreal / vindex / vmask      vector of MMD_float, of int, cutoff mask
+   V_*                         arithmetic, aligned loads, gathers and masking on vreal
+   I_*                         int vectors (gather indices)
+   M_CUTOFF(rsq, cut)          0 < rsq < cut, so neighbor padding drops out */
+
+#include <immintrin.h>
+#include "types.h"
+
+#define SIMD_ISA_avx2 1
+#define SIMD_ISA_avx512 2
+#define SIMD_ISA_ID_(isa) SIMD_ISA_##isa
+#define SIMD_ISA_ID(isa) SIMD_ISA_ID_(isa)
+
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+#undef vreal
+#undef vmask
+#undef vindex
+#undef V_ZERO
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_DIV
+#undef V_FMA
+#undef V_MIN
+#undef V_SQRT
+#undef V_LOAD
+#undef V_STORE
+#undef V_GATHER
+#undef V_MASKZ
+#undef V_HSUM
+#undef V_CVTI
+#undef M_CUTOFF
+#undef I_LOAD
+#undef I_SET1
+#undef I_ADD
+#undef I_MULC
+#undef I_MIN
+#undef I_MAX
+#undef I_CVTV
+
+#if SIMD_ISA_ID(SIMD_ISA) == SIMD_ISA_avx2
+
+/* AVX2 + FMA, 4 doubles or 8 floats per vector, masks are vectors */
+
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+
+#if PRECISION==1
+#define SIMD_WIDTH 8
+#define vreal __m256
+#define vmask __m256
+#define vindex __m256i
+#define V_ZERO() _mm256_setzero_ps()
+#define V_SET1(a) _mm256_set1_ps(a)
+#define V_ADD(a, b) _mm256_add_ps(a, b)
+#define V_SUB(a, b) _mm256_sub_ps(a, b)
+#define V_MUL(a, b) _mm256_mul_ps(a, b)
+#define V_DIV(a, b) _mm256_div_ps(a, b)
+#define V_FMA(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define V_MIN(a, b) _mm256_min_ps(a, b)
+#define V_SQRT(a) _mm256_sqrt_ps(a)
+#define V_LOAD(p) _mm256_load_ps(p)
+#define V_STORE(p, a) _mm256_store_ps(p, a)
+#define V_GATHER(base, idx) _mm256_i32gather_ps(base, idx, 4)
+#define V_MASKZ(m, a) _mm256_and_ps(m, a)
+#define V_HSUM(a) simd_hsum_avx2(a)
+#define V_CVTI(i) _mm256_cvtepi32_ps(i)
+#define M_CUTOFF(rsq, cut) _mm256_and_ps(_mm256_cmp_ps(rsq, cut, _CMP_LT_OQ), _mm256_cmp_ps(rsq, _mm256_setzero_ps(), _CMP_GT_OQ))
+#define I_LOAD(p) _mm256_loadu_si256((const __m256i*) (p))
+#define I_SET1(a) _mm256_set1_epi32(a)
+#define I_ADD(a, b) _mm256_add_epi32(a, b)
+#define I_MULC(i, c) _mm256_mullo_epi32(i, _mm256_set1_epi32(c))
+#define I_MIN(a, b) _mm256_min_epi32(a, b)
+#define I_MAX(a, b) _mm256_max_epi32(a, b)
+#define I_CVTV(a) _mm256_cvttps_epi32(a)
+#else
+#define SIMD_WIDTH 4
+#define vreal __m256d
+#define vmask __m256d
+#define vindex __m128i
+#define V_ZERO() _mm256_setzero_pd()
+#define V_SET1(a) _mm256_set1_pd(a)
+#define V_ADD(a, b) _mm256_add_pd(a, b)
+#define V_SUB(a, b) _mm256_sub_pd(a, b)
+#define V_MUL(a, b) _mm256_mul_pd(a, b)
+#define V_DIV(a, b) _mm256_div_pd(a, b)
+#define V_FMA(a, b, c) _mm256_fmadd_pd(a, b, c)
+#define V_MIN(a, b) _mm256_min_pd(a, b)
+#define V_SQRT(a) _mm256_sqrt_pd(a)
+#define V_LOAD(p) _mm256_load_pd(p)
+#define V_STORE(p, a) _mm256_store_pd(p, a)
+#define V_GATHER(base, idx) _mm256_i32gather_pd(base, idx, 8)
+#define V_MASKZ(m, a) _mm256_and_pd(m, a)
+#define V_HSUM(a) simd_hsum_avx2(a)
+#define V_CVTI(i) _mm256_cvtepi32_pd(i)
+#define M_CUTOFF(rsq, cut) _mm256_and_pd(_mm256_cmp_pd(rsq, cut, _CMP_LT_OQ), _mm256_cmp_pd(rsq, _mm256_setzero_pd(), _CMP_GT_OQ))
+#define I_LOAD(p) _mm_loadu_si128((const __m128i*) (p))
+#define I_SET1(a) _mm_set1_epi32(a)
+#define I_ADD(a, b) _mm_add_epi32(a, b)
+#define I_MULC(i, c) _mm_mullo_epi32(i, _mm_set1_epi32(c))
+#define I_MIN(a, b) _mm_min_epi32(a, b)
+#define I_MAX(a, b) _mm_max_epi32(a, b)
+#define I_CVTV(a) _mm256_cvttpd_epi32(a)
+#endif
+
+#ifndef SIMD_HSUM_AVX2
+#define SIMD_HSUM_AVX2
+
+SIMD_TARGET static inline MMD_float simd_hsum_avx2(vreal a)
+{
+  MMD_float t[SIMD_WIDTH] __attribute__((aligned(64)));
+  MMD_float sum = 0;
+  V_STORE(t, a);
+
+  for(int l = 0; l < SIMD_WIDTH; l++) sum += t[l];
+
+  return sum;
+}
+#endif
+
+#elif SIMD_ISA_ID(SIMD_ISA) == SIMD_ISA_avx512
+
+/* AVX-512F, 8 doubles or 16 floats per vector, masks are mask registers */
+
+#define SIMD_TARGET __attribute__((target("avx512f")))
+
+#if PRECISION==1
+#define SIMD_WIDTH 16
+#define vreal __m512
+#define vmask __mmask16
+#define vindex __m512i
+#define V_ZERO() _mm512_setzero_ps()
+#define V_SET1(a) _mm512_set1_ps(a)
+#define V_ADD(a, b) _mm512_add_ps(a, b)
+#define V_SUB(a, b) _mm512_sub_ps(a, b)
+#define V_MUL(a, b) _mm512_mul_ps(a, b)
+#define V_DIV(a, b) _mm512_div_ps(a, b)
+#define V_FMA(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define V_MIN(a, b) _mm512_min_ps(a, b)
+#define V_SQRT(a) _mm512_sqrt_ps(a)
+#define V_LOAD(p) _mm512_load_ps(p)
+#define V_STORE(p, a) _mm512_store_ps(p, a)
+#define V_GATHER(base, idx) _mm512_i32gather_ps(idx, base, 4)
+#define V_MASKZ(m, a) _mm512_maskz_mov_ps(m, a)
+#define V_HSUM(a) _mm512_reduce_add_ps(a)
+#define V_CVTI(i) _mm512_cvtepi32_ps(i)
+#define M_CUTOFF(rsq, cut) (_mm512_cmp_ps_mask(rsq, cut, _CMP_LT_OQ) & _mm512_cmp_ps_mask(rsq, _mm512_setzero_ps(), _CMP_GT_OQ))
+#define I_LOAD(p) _mm512_loadu_si512((const void*) (p))
+#define I_SET1(a) _mm512_set1_epi32(a)
+#define I_ADD(a, b) _mm512_add_epi32(a, b)
+#define I_MULC(i, c) _mm512_mullo_epi32(i, _mm512_set1_epi32(c))
+#define I_MIN(a, b) _mm512_min_epi32(a, b)
+#define I_MAX(a, b) _mm512_max_epi32(a, b)
+#define I_CVTV(a) _mm512_cvttps_epi32(a)
+#else
+#define SIMD_WIDTH 8
+#define vreal __m512d
+#define vmask __mmask8
+#define vindex __m256i
+#define V_ZERO() _mm512_setzero_pd()
+#define V_SET1(a) _mm512_set1_pd(a)
+#define V_ADD(a, b) _mm512_add_pd(a, b)
+#define V_SUB(a, b) _mm512_sub_pd(a, b)
+#define V_MUL(a, b) _mm512_mul_pd(a, b)
+#define V_DIV(a, b) _mm512_div_pd(a, b)
+#define V_FMA(a, b, c) _mm512_fmadd_pd(a, b, c)
+#define V_MIN(a, b) _mm512_min_pd(a, b)
+#define V_SQRT(a) _mm512_sqrt_pd(a)
+#define V_LOAD(p) _mm512_load_pd(p)
+#define V_STORE(p, a) _mm512_store_pd(p, a)
+#define V_GATHER(base, idx) _mm512_i32gather_pd(idx, base, 8)
+#define V_MASKZ(m, a) _mm512_maskz_mov_pd(m, a)
+#define V_HSUM(a) _mm512_reduce_add_pd(a)
+#define V_CVTI(i) _mm512_cvtepi32_pd(i)
+#define M_CUTOFF(rsq, cut) (_mm512_cmp_pd_mask(rsq, cut, _CMP_LT_OQ) & _mm512_cmp_pd_mask(rsq, _mm512_setzero_pd(), _CMP_GT_OQ))
+#define I_LOAD(p) _mm256_loadu_si256((const __m256i*) (p))
+#define I_SET1(a) _mm256_set1_epi32(a)
+#define I_ADD(a, b) _mm256_add_epi32(a, b)
+#define I_MULC(i, c) _mm256_mullo_epi32(i, _mm256_set1_epi32(c))
+#define I_MIN(a, b) _mm256_min_epi32(a, b)
+#define I_MAX(a, b) _mm256_max_epi32(a, b)
+#define I_CVTV(a) _mm512_cvttpd_epi32(a)
+#endif
+
+#else
+#error "simd_isa.h: SIMD_ISA must be avx2 or avx512"
+#endif
+
+#if CHUNKSIZE % SIMD_WIDTH
+#error "CHUNKSIZE must be a multiple of the SIMD width"
+#endif
@@ -37,7 +37,8 @@
 #define TIME_FORCE 2
 #define TIME_NEIGH 3
 #define TIME_TEST 4
-#define TIME_N     5
+#define TIME_SORT 5
+#define TIME_N     6
 
 #include "threadData.h"
 //#include <ctime>
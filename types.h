@@ -37,6 +37,18 @@ typedef enum{
     FORCEEAM
 }ForceStyle;
 
+typedef enum{
+    HALFNEIGH_PRIVATE,
+    HALFNEIGH_ATOMIC,
+    HALFNEIGH_COLOR
+}HalfneighThreading;
+
+typedef enum{
+    SIMD_NONE,
+    SIMD_AVX2,
+    SIMD_AVX512
+}SimdIsa;
+
 
 struct double2 {
   double x, y;
@@ -51,8 +63,11 @@ struct float4 {
   float x, y, z, w;
 };
 
+// neighbor lists are padded (with the atom itself) to a multiple of
+// CHUNKSIZE entries, so the intrinsics kernels need no remainder loop;
+// must be a multiple of the widest SIMD width (16 floats for AVX-512)
 #ifndef CHUNKSIZE
-#define CHUNKSIZE 64
+#define CHUNKSIZE 16
 #endif
 
 #ifndef PRECISION
@@ -67,6 +82,15 @@ typedef double MMD_float;
 typedef struct double2 MMD_float2;
 typedef struct double4 MMD_float4;
 #endif
+
+// precision of the pair math (distances, sr6, EAM splines) in the force kernels;
+// PRECISION 3 is the mixed mode: float pair math while positions, force sums,
+// energies and the integration stay in double (MMD_float)
+#if PRECISION==1 || PRECISION==3
+typedef float MMD_pfloat;
+#else
+typedef double MMD_pfloat;
+#endif
 typedef int MMD_int;
 typedef int MMD_bigint;
 